@@ -0,0 +1,156 @@
+#include <vsg/all.h>
+
+#include <osg2vsg/CullHierarchy.h>
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+// plane with an inward facing normal, points inside the frustum have dot(normal, point) + distance >= 0
+struct Plane
+{
+    vsg::vec3 normal;
+    float distance;
+};
+
+using Frustum = std::array<Plane, 6>;
+
+Frustum createFrustum(const vsg::vec3& eye, const vsg::vec3& forward, float fieldOfView, float nearDistance, float farDistance)
+{
+    vsg::vec3 up = (std::abs(forward.z) < 0.9f) ? vsg::vec3(0.0f, 0.0f, 1.0f) : vsg::vec3(1.0f, 0.0f, 0.0f);
+    vsg::vec3 right = vsg::normalize(vsg::cross(forward, up));
+    up = vsg::cross(right, forward);
+
+    float s = std::sin(fieldOfView*0.5f);
+    float c = std::cos(fieldOfView*0.5f);
+
+    auto sidePlane = [&](const vsg::vec3& normal) { return Plane{normal, -vsg::dot(normal, eye)}; };
+
+    return Frustum{
+        sidePlane(forward*s + right*c),
+        sidePlane(forward*s - right*c),
+        sidePlane(forward*s + up*c),
+        sidePlane(forward*s - up*c),
+        Plane{forward, -vsg::dot(forward, eye) - nearDistance},
+        Plane{-forward, vsg::dot(forward, eye) + farDistance}
+    };
+}
+
+// cull traversal done on the CPU, counting the spheres tested and the leaves that pass
+class CullCounter : public vsg::ConstVisitor
+{
+public:
+    Frustum frustum;
+    uint64_t numSphereTests = 0;
+    uint64_t numVisibleLeaves = 0;
+
+    bool intersects(const vsg::sphere& bound)
+    {
+        ++numSphereTests;
+        for(auto& plane : frustum)
+        {
+            if (vsg::dot(plane.normal, bound.center) + plane.distance < -bound.radius) return false;
+        }
+        return true;
+    }
+
+    void apply(const vsg::Node& node) override
+    {
+        node.traverse(*this);
+    }
+
+    void apply(const vsg::CullGroup& cullGroup) override
+    {
+        if (intersects(cullGroup.getBound())) cullGroup.traverse(*this);
+    }
+
+    void apply(const vsg::CullNode& cullNode) override
+    {
+        if (intersects(cullNode.getBound())) ++numVisibleLeaves;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    vsg::CommandLine arguments(&argc, argv);
+
+    auto numLeaves = arguments.value(100000u, "-n");
+    auto numFrustums = arguments.value(1000u, "-f");
+    auto fanOut = arguments.value(4u, "--fan-out");
+    auto sceneSize = arguments.value(1000.0f, "--size");
+    auto seed = arguments.value(1u, "--seed");
+
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> position(0.0f, sceneSize);
+    std::uniform_real_distribution<float> radius(sceneSize*0.0005f, sceneSize*0.005f);
+    std::normal_distribution<float> direction(0.0f, 1.0f);
+
+    // leaves scattered through a cube, all directly under one group as they are without a cull hierarchy
+    osg2vsg::CullItems items;
+    auto flat = vsg::Group::create();
+    for(uint32_t i=0; i<numLeaves; ++i)
+    {
+        vsg::sphere bound(position(generator), position(generator), position(generator), radius(generator));
+        auto cullNode = vsg::CullNode::create(bound, vsg::Group::create());
+        flat->addChild(cullNode);
+        items.push_back(osg2vsg::CullItem{bound, cullNode});
+    }
+
+    using clock = std::chrono::high_resolution_clock;
+    auto milliseconds = [](clock::duration duration) { return std::chrono::duration<double, std::chrono::milliseconds::period>(duration).count(); };
+
+    clock::time_point before_build = clock::now();
+
+    auto hierarchy = osg2vsg::createCullHierarchy(items, fanOut);
+
+    double buildTime = milliseconds(clock::now() - before_build);
+
+    std::vector<Frustum> frustums;
+    for(uint32_t i=0; i<numFrustums; ++i)
+    {
+        vsg::vec3 eye(position(generator), position(generator), position(generator));
+        vsg::vec3 forward = vsg::normalize(vsg::vec3(direction(generator), direction(generator), direction(generator)));
+        frustums.push_back(createFrustum(eye, forward, vsg::radians(60.0f), sceneSize*0.001f, sceneSize*0.5f));
+    }
+
+    auto cull = [&](const vsg::Node& root, uint64_t& numSphereTests, uint64_t& numVisibleLeaves)
+    {
+        CullCounter counter;
+        clock::time_point start = clock::now();
+        for(auto& frustum : frustums)
+        {
+            counter.frustum = frustum;
+            root.accept(counter);
+        }
+        numSphereTests = counter.numSphereTests;
+        numVisibleLeaves = counter.numVisibleLeaves;
+        return milliseconds(clock::now() - start);
+    };
+
+    uint64_t flatTests = 0, flatVisible = 0;
+    double flatTime = cull(*flat, flatTests, flatVisible);
+
+    uint64_t hierarchyTests = 0, hierarchyVisible = 0;
+    double hierarchyTime = cull(*hierarchy, hierarchyTests, hierarchyVisible);
+
+    std::cout<<"numLeaves : "<<numLeaves<<std::endl;
+    std::cout<<"numFrustums : "<<numFrustums<<std::endl;
+    std::cout<<"hierarchy build time : "<<buildTime<<"ms"<<std::endl;
+    std::cout<<std::endl;
+    std::cout<<"flat cull time : "<<flatTime<<"ms, "<<double(flatTests)/numFrustums<<" sphere tests per frustum"<<std::endl;
+    std::cout<<"hierarchy cull time : "<<hierarchyTime<<"ms, "<<double(hierarchyTests)/numFrustums<<" sphere tests per frustum"<<std::endl;
+    std::cout<<"average visible leaves : "<<double(flatVisible)/numFrustums<<std::endl;
+    std::cout<<"Speed up : "<<flatTime/hierarchyTime<<std::endl;
+
+    if (flatVisible!=hierarchyVisible)
+    {
+        std::cout<<"Error: hierarchy culled "<<hierarchyVisible<<" visible leaves, flat group "<<flatVisible<<std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -231,6 +231,15 @@ int main(int argc, char** argv)
     if (arguments.read("--no-cull-nodes")) buildOptions->insertCullNodes = false;
     if (arguments.read("--no-culling")) { buildOptions->insertCullGroups = false; buildOptions->insertCullNodes = false; }
     if (arguments.read("--billboard-transform")) { buildOptions->billboardTransform = true; }
+    if (arguments.read("--cull-hierarchy")) buildOptions->buildCullHierarchy = true;
+    if (arguments.read("--box-bounds")) buildOptions->tightBoundingSpheres = false;
+    if (arguments.read("--flatten-transforms")) buildOptions->flattenStaticTransforms = true;
+    if (arguments.read("--depth-sort")) buildOptions->depthSortTransparent = true;
+    if (arguments.read("--front-to-back")) buildOptions->frontToBackOpaque = true;
+    if (arguments.read("--material-buffer")) buildOptions->materialBuffer = true;
+    if (arguments.read("--bindless")) buildOptions->bindlessTextures = true;
+    arguments.read("--max-push-constants", buildOptions->maxPushConstantsSize);
+    arguments.read("--cull-hierarchy-fan-out", buildOptions->cullHierarchyFanOut);
     if (arguments.read("--Geometry")) { buildOptions->geometryTarget = osg2vsg::VSG_GEOMETRY; }
     if (arguments.read("--VertexIndexDraw")) { buildOptions->geometryTarget = osg2vsg::VSG_VERTEXINDEXDRAW; }
     if (arguments.read("--Commands")) { buildOptions->geometryTarget = osg2vsg::VSG_COMMANDS; }
@@ -242,7 +251,25 @@ int main(int argc, char** argv)
     auto printStats = arguments.read({"-s", "--stats"});
     auto pathFilename = arguments.value(std::string(),"-p");
     auto batchLeafData = arguments.read("--batch");
+    auto reconvert = arguments.read("--reconvert");
+    auto traceFilename = arguments.value(std::string(), "--trace");
     auto simulationFrameRate = arguments.value(0.0, "--sim-fps");
+    arguments.read("--threads", buildOptions->numThreads);
+    arguments.read("--partition-depth", buildOptions->traversalPartitionDepth);
+    if (arguments.read("--box-mipmaps")) buildOptions->mipmapFilter = osg2vsg::MIPMAP_FILTER_BOX;
+    if (arguments.read("--kaiser-mipmaps")) buildOptions->mipmapFilter = osg2vsg::MIPMAP_FILTER_KAISER;
+    if (arguments.read("--no-srgb")) buildOptions->sRGBDiffuseTextures = false;
+    if (arguments.read("--compress-fast")) buildOptions->textureCompression = osg2vsg::TEXTURE_COMPRESSION_FAST;
+    if (arguments.read("--compress-quality")) buildOptions->textureCompression = osg2vsg::TEXTURE_COMPRESSION_QUALITY;
+    arguments.read("--atlas", buildOptions->maxTextureAtlasSize);
+    arguments.read("--max-texture-size", buildOptions->maxTextureDimension);
+    if (uint32_t textureBudgetMB = 0; arguments.read("--texture-budget", textureBudgetMB)) buildOptions->textureMemoryBudget = static_cast<uint64_t>(textureBudgetMB)*1024*1024;
+    uint64_t gpuMemoryBudget = 0;
+    if (uint32_t gpuBudgetMB = 0; arguments.read("--gpu-memory-budget", gpuBudgetMB)) gpuMemoryBudget = static_cast<uint64_t>(gpuBudgetMB)*1024*1024;
+    if (arguments.read("--no-opacity-analysis")) buildOptions->analyseOpacity = false;
+    if (arguments.read("--rgb8")) buildOptions->formatProfile.sampledFormats.insert(VK_FORMAT_R8G8B8_UNORM);
+    if (arguments.read("--half-float")) buildOptions->formatProfile.sampledFormats.insert({VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT});
+    if (!arguments.read("--no-texture-registry")) buildOptions->textureRegistry = osg2vsg::TextureRegistry::create();
     arguments.read({"--support-mask", "--sm"}, buildOptions->supportedShaderModeMask);
     arguments.read({"--override-mask", "--om"}, buildOptions->overrideShaderModeMask);
     arguments.read({ "--vertex-shader", "--vert" }, buildOptions->vertexShaderPath);
@@ -251,6 +278,30 @@ int main(int argc, char** argv)
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
+    // when viewing, create the window before converting so the scene is built for the limits of its device
+    vsg::ref_ptr<vsg::Window> window;
+    if (outputFilename.empty())
+    {
+        window = vsg::Window::create(windowTraits);
+        if (!window)
+        {
+            std::cout<<"Could not create windows."<<std::endl;
+            return 1;
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(*(window->physicalDevice()), &properties);
+        buildOptions->maxPushConstantsSize = properties.limits.maxPushConstantsSize;
+    }
+
+    if ((buildOptions->materialBuffer || buildOptions->bindlessTextures) && !osg2vsg::supportsMaterialBuffer(buildOptions->maxPushConstantsSize))
+    {
+        std::cout<<"Warning: --material-buffer and --bindless need a maxPushConstantsSize of at least "<<osg2vsg::MATERIAL_INDEX_PUSH_CONSTANT_OFFSET + sizeof(uint32_t)
+                 <<" bytes, the device has "<<buildOptions->maxPushConstantsSize<<", using per state materials instead."<<std::endl;
+        buildOptions->materialBuffer = false;
+        buildOptions->bindlessTextures = false;
+    }
+
     osg2vsg::SceneBuilder sceneBuilder(buildOptions);
 
     // read shaders
@@ -258,6 +309,8 @@ int main(int argc, char** argv)
 
     using VsgNodes = std::vector<vsg::ref_ptr<vsg::Node>>;
     VsgNodes vsgNodes;
+    std::vector<vsg::ref_ptr<osg2vsg::ViewSorter>> viewSorters;
+    uint32_t numBindlessTextures = 0;
 
     // read any vsg files
     vsg::ReaderWriter_vsg io;
@@ -301,6 +354,14 @@ int main(int argc, char** argv)
     {
         std::cout<<"OSG loadTime = "<<osg_loadTime<<"ms"<<std::endl;
 
+        // atlas first, so the optimizer's SHARE_DUPLICATE_STATE merges the statesets that now share an atlas
+        if (buildOptions->maxTextureAtlasSize>0)
+        {
+            osg2vsg::OptimizeOsgTextureAtlases optimizeTextureAtlases(buildOptions->maxTextureAtlasSize);
+            optimizeTextureAtlases.optimize(osg_scene.get());
+            optimizeTextureAtlases.report(std::cout);
+        }
+
         if (optimize)
         {
             osgUtil::IndexMeshVisitor imv;
@@ -334,16 +395,60 @@ int main(int argc, char** argv)
             osgSceneAnalysis._sceneStats->print(std::cout);
         }
 
+        vsg::ref_ptr<osg2vsg::ChromeTraceWriter> traceWriter;
+        if (!traceFilename.empty())
+        {
+            traceWriter = osg2vsg::ChromeTraceWriter::create();
+            buildOptions->observer = traceWriter;
+        }
+
+        // the osg scene is only read again when reconverting it or writing it out, otherwise its images can be moved rather than copied
+        buildOptions->releaseSourceImages = !reconvert && (outputFilename.empty() || vsg::fileExtension(outputFilename).compare(0, 3, "osg")!=0);
+
         // Collect stats about the loaded scene for the purpose of rebuild it
         sceneBuilder.writeToFileProgramAndDataSetSets = writeToFileProgramAndDataSetSets;
-        osg_scene->accept(sceneBuilder);
+        sceneBuilder.traverseScene(*osg_scene);
 
         // build VSG scene
         vsg::ref_ptr<vsg::Node> converted_vsg_scene = sceneBuilder.createVSG(searchPaths);
 
+        // convert the unchanged scene again as an editor would after each edit, which should reuse all of the first conversion
+        if (reconvert)
+        {
+            if (printStats) sceneBuilder.printPhaseTimings(std::cout);
+
+            converted_vsg_scene = sceneBuilder.updateVSG(*osg_scene, searchPaths);
+
+            auto& stats = sceneBuilder.reconversionStats;
+            std::cout<<"Reconverted geometries = "<<stats.numConvertedGeometries<<", reused = "<<stats.numReusedGeometries<<std::endl;
+            std::cout<<"Reconverted textures = "<<stats.numConvertedTextures<<", reused = "<<stats.numReusedTextures<<std::endl;
+            std::cout<<"Recreated descriptor sets = "<<stats.numCreatedDescriptorSets<<", reused = "<<stats.numReusedDescriptorSets<<std::endl;
+            std::cout<<"Rebuilt state subgraphs = "<<stats.numCreatedStateGraphs<<", reused = "<<stats.numReusedStateGraphs<<std::endl;
+        }
+
+        if (converted_vsg_scene && buildOptions->textureMemoryBudget>0 && sceneBuilder.estimatedTextureMemory>buildOptions->textureMemoryBudget)
+        {
+            std::cout<<"Warning: texture memory budget of "<<buildOptions->textureMemoryBudget<<" bytes can't be met, estimated texture memory "<<sceneBuilder.estimatedTextureMemory<<" bytes."<<std::endl;
+        }
+
+        if (traceWriter && traceWriter->write(traceFilename))
+        {
+            std::cout<<"Written "<<traceWriter->getNumEvents()<<" conversion phases to "<<traceFilename<<std::endl;
+        }
+
+        if (printStats)
+        {
+            sceneBuilder.printPhaseTimings(std::cout);
+            std::cout<<"Average bounding sphere volume relative to bounding box spheres = "<<sceneBuilder.averageSphereVolumeRatio<<std::endl;
+            std::cout<<"State descriptor sets = "<<sceneBuilder.numStateDescriptorSets<<", materials in material buffer = "<<sceneBuilder.numBufferedMaterials<<std::endl;
+            if (buildOptions->bindlessTextures) std::cout<<"Textures in bindless texture array = "<<sceneBuilder.numBindlessTextures<<std::endl;
+        }
+
         if (converted_vsg_scene)
         {
             vsgNodes.push_back(converted_vsg_scene);
+            if (sceneBuilder.viewSorter) viewSorters.push_back(sceneBuilder.viewSorter);
+            numBindlessTextures = std::max(numBindlessTextures, sceneBuilder.bindlessTextureCapacity);
         }
 
     }
@@ -401,17 +506,35 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    if (printStats)
+    if (printStats || gpuMemoryBudget>0)
     {
         osg2vsg::VsgSceneAnalysis vsgSceneAnalysis;
         vsg_scene->accept(vsgSceneAnalysis);
-        vsgSceneAnalysis._sceneStats->print(std::cout);
+        if (printStats)
+        {
+            vsgSceneAnalysis._sceneStats->print(std::cout);
+
+            if (buildOptions->textureRegistry)
+            {
+                auto textureStats = buildOptions->textureRegistry->getStats();
+                std::cout<<"TextureRegistry "<<textureStats.numImageRequests<<" image requests, "<<textureStats.numUniqueImages<<" unique images, "
+                         <<textureStats.numUniqueSamplers<<" unique samplers, "<<textureStats.numUniqueDescriptorImages<<" unique DescriptorImages"<<std::endl;
+            }
+        }
+
+        // exit with an error when the scene won't fit, so datasets can be checked against a budget before they ship
+        auto gpuBytes = vsgSceneAnalysis._sceneStats->memory.totalGpuBytes();
+        if (gpuMemoryBudget>0 && gpuBytes>gpuMemoryBudget)
+        {
+            std::cout<<"Warning: estimated GPU memory of "<<gpuBytes<<" bytes exceeds the budget of "<<gpuMemoryBudget<<" bytes."<<std::endl;
+            return 1;
+        }
     }
 
     // create the viewer and assign window(s) to it
     auto viewer = vsg::Viewer::create();
 
-    vsg::ref_ptr<vsg::Window> window(vsg::Window::create(windowTraits));
+    if (!window) window = vsg::Window::create(windowTraits);
     if (!window)
     {
         std::cout<<"Could not create windows."<<std::endl;
@@ -420,6 +543,13 @@ int main(int argc, char** argv)
 
     viewer->addWindow(window);
 
+    // the bindless shaders can't be rendered without descriptor indexing, so refuse rather than record invalid commands
+    if (buildOptions->bindlessTextures && !osg2vsg::supportsBindlessTextures(*(window->physicalDevice()), numBindlessTextures))
+    {
+        std::cout<<"Warning: device does not support the descriptor indexing features required by --bindless for "<<numBindlessTextures<<" textures, rerun without --bindless."<<std::endl;
+        return 1;
+    }
+
 
     // compute the bounds of the scene graph to help position camera
     vsg::ComputeBounds computeBounds;
@@ -479,6 +609,13 @@ int main(int argc, char** argv)
 
         viewer->update();
 
+        // reorder the depth sorted and front to back groups for this frame's view
+        if (auto viewLookAt = dynamic_cast<vsg::LookAt*>(camera->getViewMatrix()); viewLookAt && !viewSorters.empty())
+        {
+            vsg::dvec3 viewDirection = vsg::normalize(viewLookAt->center - viewLookAt->eye);
+            for(auto& viewSorter : viewSorters) viewSorter->sort(viewLookAt->eye, viewDirection);
+        }
+
         viewer->recordAndSubmit();
 
         viewer->present();
@@ -15,6 +15,24 @@
 
 using namespace osg2vsg;
 
+namespace
+{
+    // collect the statesets of the nodes and drawables in a subgraph
+    class CollectStateSets : public osg::NodeVisitor
+    {
+    public:
+        CollectStateSets() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+        std::vector<osg::ref_ptr<osg::StateSet>> statesets;
+        std::set<const osg::StateSet*> visited;
+
+        void add(osg::StateSet* stateset) { if (stateset && visited.insert(stateset).second) statesets.push_back(stateset); }
+
+        void apply(osg::Node& node) override { add(node.getStateSet()); traverse(node); }
+        void apply(osg::Drawable& drawable) override { add(drawable.getStateSet()); }
+    };
+}
+
 vsg::ref_ptr<vsg::BindGraphicsPipeline> ConvertToVsg::getOrCreateBindGraphicsPipeline(uint32_t shaderModeMask, uint32_t geometryMask)
 {
     return buildOptions->pipelineCache->getOrCreateBindGraphicsPipeline(shaderModeMask, geometryMask, buildOptions->vertexShaderPath, buildOptions->fragmentShaderPath);
@@ -89,6 +107,15 @@ void ConvertToVsg::optimize(osg::Node* osg_scene)
     optimizeBillboards.optimize();
 }
 
+void ConvertToVsg::convertSceneTextures(osg::Node* node)
+{
+    if (!node) return;
+
+    CollectStateSets collectStateSets;
+    node->accept(collectStateSets);
+    convertTextures(collectStateSets.statesets);
+}
+
 vsg::ref_ptr<vsg::Node> ConvertToVsg::convert(osg::Node* node)
 {
     root = nullptr;
@@ -183,7 +210,13 @@ void ConvertToVsg::apply(osg::Geometry& geometry)
     ScopedPushPop spp(*this, geometry.getStateSet());
 
     uint32_t geometryMask = (osg2vsg::calculateAttributesMask(&geometry) | buildOptions->overrideGeomAttributes) & buildOptions->supportedGeometryAttributes;
-    uint32_t shaderModeMask = (calculateShaderModeMask() | buildOptions->overrideShaderModeMask | nodeShaderModeMasks) & buildOptions->supportedShaderModeMask;
+    uint32_t shaderModeMask = calculateShaderModeMask() | nodeShaderModeMasks;
+    if (!statestack.empty())
+    {
+        shaderModeMask = classifyNormalMap(getStatePair().second, shaderModeMask);
+        shaderModeMask = classifyOpacity(getStatePair().second, &geometry, shaderModeMask);
+    }
+    shaderModeMask = (shaderModeMask | buildOptions->overrideShaderModeMask) & buildOptions->supportedShaderModeMask;
 
     // std::cout<<"Have geometry with "<<statestack.size()<<" shaderModeMask="<<shaderModeMask<<", geometryMask="<<geometryMask<<std::endl;
 
@@ -72,6 +72,9 @@ public:
 
     void optimize(osg::Node* osg_scene);
 
+    // convert the textures of every stateset in the subgraph up front, required before convert() when BuildOptions::releaseSourceImages is set
+    void convertSceneTextures(osg::Node* node);
+
     vsg::ref_ptr<vsg::Node> convert(osg::Node* node);
 
     template<class V>
@@ -95,12 +98,12 @@ public:
             convertToVsg(conv),
             stateset(ss)
         {
-            if (stateset) convertToVsg.statestack.push_back(stateset);
+            if (stateset) convertToVsg.pushStateSet(*stateset);
         }
 
         ~ScopedPushPop()
         {
-            if (stateset) convertToVsg.statestack.pop_back();
+            if (stateset) convertToVsg.popStateSet();
         }
     };
 
@@ -28,6 +28,7 @@ int main(int argc, char** argv)
     auto levels = arguments.value(30, "-l");
     uint32_t numThreads = arguments.value(16, "-t");
     uint32_t numTilesBelow = arguments.value(0, "-n");
+    uint64_t textureCacheSize = arguments.value(uint64_t(1024), "--texture-cache") * 1024 * 1024; // megabytes of unused textures kept for later tiles
 
     if (arguments.read("--ext", buildOptions->extension)) {}
     if (arguments.read("--cull-nodes")) buildOptions->insertCullNodes = true;
@@ -39,6 +40,12 @@ int main(int argc, char** argv)
     if (arguments.read("--Commands")) { buildOptions->geometryTarget = osg2vsg::VSG_COMMANDS; }
     if (arguments.read({"--bind-single-ds", "--bsds"})) buildOptions->useBindDescriptorSet = true;
 
+    // share textures with the same contents between all the tiles, rather than converting them per tile
+    buildOptions->textureRegistry = osg2vsg::TextureRegistry::create();
+
+    // each tile's osg scene is discarded once converted, so its images can be moved rather than copied
+    buildOptions->releaseSourceImages = true;
+
     if (inputFilename.empty() || outputFilename.empty())
     {
         std::cout<<"Please support an input and output filenames via -i inputfilename.ext -o outputfile.ext"<<std::endl;
@@ -55,7 +62,7 @@ int main(int argc, char** argv)
         ReadOperation(vsg::observer_ptr<vsg::OperationQueue> q, vsg::ref_ptr<vsg::Latch> l, vsg::ref_ptr<const osg2vsg::BuildOptions> bo,
                       const std::string& inPath, const std::string& inFilename,
                       const vsg::Path& outPath, const vsg::Path& outFilename,
-                      int cl, int ml, uint32_t ntb,
+                      int cl, int ml, uint32_t ntb, uint64_t tcs,
                       vsg::ref_ptr<vsg::StateGroup> in_inheritedStateGroup = {}) :
             queue(q),
             latch(l),
@@ -67,6 +74,7 @@ int main(int argc, char** argv)
             level(cl),
             maxLevel(ml),
             numTilesBelow(ntb),
+            textureCacheSize(tcs),
             inheritedStateGroup(in_inheritedStateGroup)
         {
         }
@@ -142,6 +150,9 @@ int main(int argc, char** argv)
 
                 sceneBuilder.optimize(osg_scene);
 
+                // the images are moved into the textures, so convert them all before the traversal reads the statesets
+                if (buildOptions->releaseSourceImages) sceneBuilder.convertSceneTextures(osg_scene);
+
                 auto vsg_scene = sceneBuilder.convert(osg_scene);
 
                 if (vsg_scene)
@@ -201,10 +212,14 @@ int main(int argc, char** argv)
                         // increment the latch as we are adding another operation to do.
                         latch->count_up();
 
-                        ref_queue->add(vsg::ref_ptr<ReadOperation>(new ReadOperation(queue, latch, buildOptions, finalInputPath, osg_filename, finalOutputPath, vsg_filename, level+1, maxLevel, numTilesBelow, inheritedStateGroup)));
+                        ref_queue->add(vsg::ref_ptr<ReadOperation>(new ReadOperation(queue, latch, buildOptions, finalInputPath, osg_filename, finalOutputPath, vsg_filename, level+1, maxLevel, numTilesBelow, textureCacheSize, inheritedStateGroup)));
                     }
                 }
             }
+
+            // this tile's textures are now only held by the registry, keep the most recently used up to the cache size for the tiles still to come
+            buildOptions->textureRegistry->releaseUnused(textureCacheSize);
+
             // we have finsihed this read operation so decrement the latch, which will release and threads waiting on it.
             latch->count_down();
 
@@ -227,6 +242,7 @@ int main(int argc, char** argv)
         int level;
         int maxLevel;
         uint32_t numTilesBelow;
+        uint64_t textureCacheSize;
         vsg::ref_ptr<vsg::StateGroup> inheritedStateGroup;
     };
 
@@ -234,11 +250,16 @@ int main(int argc, char** argv)
 
     vsg::observer_ptr<vsg::OperationQueue> obs_queue(operationQueue);
 
-    operationQueue->add(vsg::ref_ptr<ReadOperation>(new ReadOperation(obs_queue, latch, buildOptions, "", inputFilename, "", outputFilename, 0, levels, numTilesBelow)));
+    operationQueue->add(vsg::ref_ptr<ReadOperation>(new ReadOperation(obs_queue, latch, buildOptions, "", inputFilename, "", outputFilename, 0, levels, numTilesBelow, textureCacheSize)));
 
     // wait until the latch goes zero i.e. all read operations have completed
     latch->wait();
 
+    auto textureStats = buildOptions->textureRegistry->getStats();
+    std::cout<<"\nTextureRegistry "<<textureStats.numImageRequests<<" image requests, "<<textureStats.numUniqueImages<<" unique images, "
+             <<textureStats.numUniqueSamplers<<" unique samplers, "<<textureStats.numUniqueDescriptorImages<<" unique DescriptorImages, "
+             <<textureStats.numBytes<<" bytes cached"<<std::endl;
+
     // signal that we are finished and the thread should close
     status->set(false);
 
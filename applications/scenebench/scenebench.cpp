@@ -0,0 +1,215 @@
+#include <osg/ArgumentParser>
+#include <osg/Geometry>
+#include <osg/MatrixTransform>
+#include <osg/Texture2D>
+
+#include <osg2vsg/SceneBuilder.h>
+#include <osg2vsg/ShaderUtils.h>
+#include <osg2vsg/GeometryUtils.h>
+
+#include <iostream>
+#include <chrono>
+#include <map>
+
+// the grouping scheme SceneBuilder used before geometry records, nested std::maps keyed on StateSet, osg::Matrix and masks
+// filled in for every geometry visited, kept here to measure against.
+class MapGroupingVisitor : public osg::NodeVisitor
+{
+public:
+    MapGroupingVisitor():
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ACTIVE_CHILDREN) {}
+
+    using Geometries = std::vector<osg::ref_ptr<osg::Geometry>>;
+    using StateGeometryMap = std::map<osg::ref_ptr<osg::StateSet>, Geometries>;
+    using TransformGeometryMap = std::map<osg::Matrix, Geometries>;
+
+    struct TransformStatePair
+    {
+        std::map<osg::Matrix, StateGeometryMap> matrixStateGeometryMap;
+        std::map<osg::ref_ptr<osg::StateSet>, TransformGeometryMap> stateTransformMap;
+    };
+
+    using Masks = std::pair<uint32_t, uint32_t>;
+
+    std::vector<osg::Matrix> matrixstack;
+    std::vector<osg::ref_ptr<osg::StateSet>> statestack;
+    std::map<osg::ref_ptr<osg::StateSet>, TransformStatePair> programTransformStateMap;
+    std::map<Masks, TransformStatePair> masksTransformStateMap;
+
+    using NodeVisitor::apply;
+
+    void apply(osg::Transform& transform) override
+    {
+        osg::Matrix matrix;
+        if (!matrixstack.empty()) matrix = matrixstack.back();
+        transform.computeLocalToWorldMatrix(matrix, this);
+
+        matrixstack.push_back(matrix);
+        traverse(transform);
+        matrixstack.pop_back();
+    }
+
+    void apply(osg::Geometry& geometry) override
+    {
+        osg::ref_ptr<osg::StateSet> stateset = geometry.getStateSet();
+
+        osg::Matrix matrix;
+        if (!matrixstack.empty()) matrix = matrixstack.back();
+
+        {
+            TransformStatePair& transformStatePair = programTransformStateMap[nullptr];
+            transformStatePair.matrixStateGeometryMap[matrix][stateset].push_back(&geometry);
+            transformStatePair.stateTransformMap[stateset][matrix].push_back(&geometry);
+        }
+
+        {
+            Masks masks(osg2vsg::calculateShaderModeMask(stateset.get()), osg2vsg::calculateAttributesMask(&geometry));
+            TransformStatePair& transformStatePair = masksTransformStateMap[masks];
+            transformStatePair.matrixStateGeometryMap[matrix][stateset].push_back(&geometry);
+            transformStatePair.stateTransformMap[stateset][matrix].push_back(&geometry);
+        }
+    }
+};
+
+// numGeometries geometries spread evenly over numTransforms transforms, cycling through numStateSets textured statesets.
+// the geometries share their arrays and primitive set so a million of them fit comfortably in memory.
+osg::ref_ptr<osg::Node> createScene(unsigned int numGeometries, unsigned int numTransforms, unsigned int numStateSets)
+{
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array{{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f}, {0.0f, 1.0f, 0.0f}};
+    osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array{{0.0f, 0.0f, 1.0f}};
+    normals->setBinding(osg::Array::BIND_OVERALL);
+    osg::ref_ptr<osg::Vec2Array> texcoords = new osg::Vec2Array{{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}};
+    osg::ref_ptr<osg::DrawArrays> primitives = new osg::DrawArrays(GL_TRIANGLE_FAN, 0, 4);
+
+    std::vector<osg::ref_ptr<osg::StateSet>> statesets;
+    for(unsigned int i=0; i<numStateSets; ++i)
+    {
+        osg::ref_ptr<osg::Image> image = new osg::Image;
+        image->allocateImage(4, 4, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        std::fill(image->data(), image->data()+image->getTotalSizeInBytes(), static_cast<unsigned char>(i));
+
+        osg::ref_ptr<osg::StateSet> stateset = new osg::StateSet;
+        stateset->setTextureAttributeAndModes(0, new osg::Texture2D(image.get()), osg::StateAttribute::ON);
+        stateset->setMode(GL_LIGHTING, (i%2==0) ? osg::StateAttribute::ON : osg::StateAttribute::OFF);
+        statesets.push_back(stateset);
+    }
+
+    osg::ref_ptr<osg::Group> root = new osg::Group;
+    unsigned int geometriesPerTransform = (numGeometries+numTransforms-1)/numTransforms;
+    unsigned int geometryIndex = 0;
+    for(unsigned int t=0; t<numTransforms && geometryIndex<numGeometries; ++t)
+    {
+        osg::ref_ptr<osg::MatrixTransform> transform = new osg::MatrixTransform(osg::Matrix::translate(static_cast<double>(t%1000), static_cast<double>(t/1000), 0.0));
+        root->addChild(transform);
+
+        for(unsigned int g=0; g<geometriesPerTransform && geometryIndex<numGeometries; ++g, ++geometryIndex)
+        {
+            osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+            geometry->setVertexArray(vertices);
+            geometry->setNormalArray(normals);
+            geometry->setTexCoordArray(0, texcoords);
+            geometry->addPrimitiveSet(primitives);
+            geometry->setStateSet(statesets[geometryIndex%numStateSets]);
+            transform->addChild(geometry);
+        }
+    }
+
+    return root;
+}
+
+int main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    unsigned int numGeometries = 1000000;
+    unsigned int numTransforms = 10000;
+    unsigned int numStateSets = 100;
+    arguments.read("-n", numGeometries);
+    arguments.read("-t", numTransforms);
+    arguments.read("-s", numStateSets);
+    bool skipMaps = arguments.read("--no-maps");
+
+    auto buildOptions = osg2vsg::BuildOptions::create();
+    arguments.read("--threads", buildOptions->numThreads);
+    arguments.read("--partition-depth", buildOptions->traversalPartitionDepth);
+    bool verify = arguments.read("--verify");
+
+    if (numTransforms==0) numTransforms = 1;
+    if (numStateSets==0) numStateSets = 1;
+
+    using clock = std::chrono::high_resolution_clock;
+    auto seconds = [](clock::duration duration) { return std::chrono::duration<double>(duration).count(); };
+
+    clock::time_point start = clock::now();
+
+    auto scene = createScene(numGeometries, numTransforms, numStateSets);
+
+    clock::time_point after_construction = clock::now();
+
+    double mapTime = 0.0;
+    if (!skipMaps)
+    {
+        MapGroupingVisitor mapGrouping;
+        scene->accept(mapGrouping);
+        mapTime = seconds(clock::now()-after_construction);
+    }
+
+    clock::time_point before_records = clock::now();
+
+    osg2vsg::SceneBuilder sceneBuilder(buildOptions);
+    sceneBuilder.traverseScene(*scene);
+
+    clock::time_point after_traversal = clock::now();
+
+    sceneBuilder.groupGeometries();
+
+    clock::time_point after_grouping = clock::now();
+
+    double traversalTime = seconds(after_traversal-before_records);
+    double groupingTime = seconds(after_grouping-after_traversal);
+
+    std::cout<<"numGeometries : "<<sceneBuilder.geometryRecords.size()<<std::endl;
+    std::cout<<"numMatrices : "<<sceneBuilder.matrices.size()<<std::endl;
+    std::cout<<"numStates : "<<sceneBuilder.states.size()<<std::endl;
+    std::cout<<"numMasks : "<<sceneBuilder.masksTransformStateMap.size()<<std::endl;
+    std::cout<<"construction time : "<<seconds(after_construction-start)<<std::endl;
+    if (!skipMaps) std::cout<<"nested map traversal time : "<<mapTime<<std::endl;
+    std::cout<<"record traversal time : "<<traversalTime<<std::endl;
+    std::cout<<"record grouping time : "<<groupingTime<<std::endl;
+    std::cout<<"record total time : "<<traversalTime+groupingTime<<std::endl;
+    std::cout<<std::endl;
+    if (!skipMaps) std::cout<<"Geometries per second, nested maps : "<<double(numGeometries)/mapTime<<std::endl;
+    std::cout<<"Geometries per second, records     : "<<double(numGeometries)/(traversalTime+groupingTime)<<std::endl;
+    if (!skipMaps) std::cout<<"Speed up : "<<mapTime/(traversalTime+groupingTime)<<std::endl;
+
+    if (verify)
+    {
+        // a partitioned traversal should produce exactly the records of a serial one, which accept() always does
+        osg2vsg::SceneBuilder serialBuilder(buildOptions);
+        scene->accept(serialBuilder);
+
+        auto equalStates = [](const osg::StateSet* lhs, const osg::StateSet* rhs) { return (lhs && rhs) ? lhs->compare(*rhs)==0 : lhs==rhs; };
+
+        bool matches = serialBuilder.geometryRecords.size()==sceneBuilder.geometryRecords.size() &&
+                       serialBuilder.matrices==sceneBuilder.matrices &&
+                       serialBuilder.states.size()==sceneBuilder.states.size();
+
+        for(size_t i=0; matches && i<serialBuilder.states.size(); ++i)
+        {
+            matches = equalStates(serialBuilder.states[i].get(), sceneBuilder.states[i].get());
+        }
+
+        for(size_t i=0; matches && i<serialBuilder.geometryRecords.size(); ++i)
+        {
+            auto& serial = serialBuilder.geometryRecords[i];
+            auto& record = sceneBuilder.geometryRecords[i];
+            matches = serial.geometry==record.geometry && serial.programStateId==record.programStateId && serial.dataStateId==record.dataStateId &&
+                      serial.matrixId==record.matrixId && serial.masks==record.masks;
+        }
+
+        std::cout<<std::endl<<"Records match serial traversal : "<<(matches ? "yes" : "no")<<std::endl;
+        if (!matches) return 1;
+    }
+
+    return 0;
+}
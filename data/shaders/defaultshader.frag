@@ -1,5 +1,5 @@
 #version 450
-#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0, VSG_LIGHTING, VSG_DIFFUSE_MAP )
+#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0, VSG_LIGHTING, VSG_DIFFUSE_MAP, VSG_ALPHA_TEST )
 #extension GL_ARB_separate_shader_objects : enable
 #ifdef VSG_DIFFUSE_MAP
 layout(binding = 0) uniform sampler2D diffuseMap;
@@ -53,6 +53,12 @@ void main()
     vec4 color = base;
 #endif
     outColor = color;
+#ifdef VSG_ALPHA_TEST
+    // binary alpha is resolved by the test so the geometry can be drawn without blending
+    if (outColor.a<0.5) discard;
+    outColor.a = 1.0;
+#else
     if (outColor.a==0.0) discard;
+#endif
 }
 
@@ -1,23 +1,64 @@
 #version 450
-#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0, VSG_LIGHTING, VSG_MATERIAL, VSG_DIFFUSE_MAP, VSG_OPACITY_MAP, VSG_AMBIENT_MAP, VSG_NORMAL_MAP, VSG_SPECULAR_MAP )
+#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0, VSG_LIGHTING, VSG_MATERIAL, VSG_DIFFUSE_MAP, VSG_OPACITY_MAP, VSG_AMBIENT_MAP, VSG_NORMAL_MAP, VSG_NORMAL_MAP_XY, VSG_SPECULAR_MAP, VSG_ALPHA_TEST, VSG_MATERIAL_BUFFER, VSG_BINDLESS_TEXTURES )
 #extension GL_ARB_separate_shader_objects : enable
+#ifdef VSG_BINDLESS_TEXTURES
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+#ifdef VSG_MATERIAL_BUFFER
+// the scene wide material buffer is bound to set 0, so the per state textures move to set 1
+#define TEXTURE_SET 1
+#else
+#define TEXTURE_SET 0
+#endif
+#ifdef VSG_BINDLESS_TEXTURES
+// every texture of the scene in one array, indexed by the texture indices held in the material
+layout(set = 0, binding = 11) uniform sampler2D textures[];
+#define diffuseMap textures[nonuniformEXT(material.diffuseMapIndex)]
+#define opacityMap textures[nonuniformEXT(material.opacityMapIndex)]
+#define ambientMap textures[nonuniformEXT(material.ambientMapIndex)]
+#define normalMap textures[nonuniformEXT(material.normalMapIndex)]
+#define specularMap textures[nonuniformEXT(material.specularMapIndex)]
+#else
 #ifdef VSG_DIFFUSE_MAP
-layout(binding = 0) uniform sampler2D diffuseMap;
+layout(set = TEXTURE_SET, binding = 0) uniform sampler2D diffuseMap;
 #endif
 #ifdef VSG_OPACITY_MAP
-layout(binding = 1) uniform sampler2D opacityMap;
+layout(set = TEXTURE_SET, binding = 1) uniform sampler2D opacityMap;
 #endif
 #ifdef VSG_AMBIENT_MAP
-layout(binding = 4) uniform sampler2D ambientMap;
+layout(set = TEXTURE_SET, binding = 4) uniform sampler2D ambientMap;
 #endif
 #ifdef VSG_NORMAL_MAP
-layout(binding = 5) uniform sampler2D normalMap;
+layout(set = TEXTURE_SET, binding = 5) uniform sampler2D normalMap;
 #endif
 #ifdef VSG_SPECULAR_MAP
-layout(binding = 6) uniform sampler2D specularMap;
+layout(set = TEXTURE_SET, binding = 6) uniform sampler2D specularMap;
+#endif
 #endif
 
-#ifdef VSG_MATERIAL
+#ifdef VSG_MATERIAL_BUFFER
+struct MaterialData
+{
+    vec4 ambientColor;
+    vec4 diffuseColor;
+    vec4 specularColor;
+    float shininess;
+    uint diffuseMapIndex;
+    uint opacityMapIndex;
+    uint ambientMapIndex;
+    uint normalMapIndex;
+    uint specularMapIndex;
+};
+layout(set = 0, binding = 10) readonly buffer MaterialBuffer
+{
+    MaterialData materials[];
+};
+layout(push_constant) uniform MaterialIndex
+{
+    layout(offset = 128) uint materialIndex;
+} pc;
+#define material materials[pc.materialIndex]
+#elif defined(VSG_MATERIAL)
 layout(binding = 10) uniform MaterialData
 {
     vec4 ambientColor;
@@ -71,7 +112,14 @@ void main()
 #endif
 #ifdef VSG_LIGHTING
 #ifdef VSG_NORMAL_MAP
+#ifdef VSG_NORMAL_MAP_XY
+    // two channel normal maps, such as BC5, only hold x and y so z is reconstructed
+    vec3 nDir;
+    nDir.xy = texture(normalMap, texCoord0.st).xy*2.0 - 1.0;
+    nDir.z = sqrt(max(1.0 - dot(nDir.xy, nDir.xy), 0.0));
+#else
     vec3 nDir = texture(normalMap, texCoord0.st).xyz*2.0 - 1.0;
+#endif
     nDir.g = -nDir.g;
 #else
     vec3 nDir = normalDir;
@@ -99,6 +147,12 @@ void main()
     outColor.a *= texture(opacityMap, texCoord0.st).r;
 #endif
 
+#ifdef VSG_ALPHA_TEST
+    // binary alpha is resolved by the test so the geometry can be drawn without blending
+    if (outColor.a<0.5) discard;
+    outColor.a = 1.0;
+#else
     // crude version of AlphaFunc
     if (outColor.a==0.0) discard;
+#endif
 }
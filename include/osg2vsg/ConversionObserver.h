@@ -0,0 +1,81 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+
+#include <vsg/core/Inherit.h>
+#include <vsg/core/Object.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace osg2vsg
+{
+    // work done by a phase of a conversion, what is counted depends on the phase, e.g. geometries converted or descriptor sets created
+    struct PhaseStats
+    {
+        uint64_t count = 0;
+        uint64_t bytes = 0; // bytes of vsg data created by the phase, 0 for phases that create none
+    };
+
+    // receives the phases of SceneBuilder::optimizeAndConvertToVsg(), createVSG() and updateVSG() as they run, assign to BuildOptions::observer.
+    // the callbacks are made from the thread calling SceneBuilder, even when the phase's work is spread over the WorkerPool.
+    class OSG2VSG_DECLSPEC ConversionObserver : public vsg::Inherit<vsg::Object, ConversionObserver>
+    {
+    public:
+        ConversionObserver() {}
+
+        virtual void beginPhase(const std::string& /*phase*/) {}
+        virtual void endPhase(const std::string& /*phase*/, const PhaseStats& /*stats*/, double /*milliseconds*/) {}
+
+        // ask the conversion to stop, it abandons the remaining work of the current phase and returns null at the end of it.
+        // can be called from any thread, including from within the callbacks
+        void cancel() { _cancelled = true; }
+        bool cancelled() const { return _cancelled; }
+
+        // clear a cancellation so the observer can be used for another conversion
+        void reset() { _cancelled = false; }
+
+    protected:
+        virtual ~ConversionObserver() {}
+
+        std::atomic<bool> _cancelled{false};
+    };
+
+    // records the phases as complete events in the Chrome trace event format, for viewing in chrome://tracing or Perfetto
+    class OSG2VSG_DECLSPEC ChromeTraceWriter : public vsg::Inherit<ConversionObserver, ChromeTraceWriter>
+    {
+    public:
+        ChromeTraceWriter();
+
+        void beginPhase(const std::string& phase) override;
+        void endPhase(const std::string& phase, const PhaseStats& stats, double milliseconds) override;
+
+        // write the phases recorded so far as a JSON trace, returns false if the file can't be written
+        bool write(const std::string& filename) const;
+        void write(std::ostream& out) const;
+
+        size_t getNumEvents() const;
+
+    protected:
+        virtual ~ChromeTraceWriter() {}
+
+        using clock = std::chrono::steady_clock;
+
+        struct Event
+        {
+            std::string name;
+            double start = 0.0; // microseconds since the writer was created
+            double duration = 0.0;
+            PhaseStats stats;
+        };
+
+        mutable std::mutex _mutex;
+        clock::time_point _startTime;
+        std::vector<std::pair<std::string, clock::time_point>> _openPhases;
+        std::vector<Event> _events;
+    };
+}
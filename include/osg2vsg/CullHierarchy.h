@@ -0,0 +1,30 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+
+#include <vsg/maths/sphere.h>
+#include <vsg/nodes/Node.h>
+
+#include <vector>
+
+namespace osg2vsg
+{
+    // node to place in a cull hierarchy, with the bounding sphere used to position it and to bound the groups above it
+    struct CullItem
+    {
+        vsg::sphere bound;
+        vsg::ref_ptr<vsg::Node> node;
+    };
+
+    using CullItems = std::vector<CullItem>;
+
+    // smallest sphere enclosing both spheres
+    extern OSG2VSG_DECLSPEC vsg::sphere mergeSpheres(const vsg::sphere& lhs, const vsg::sphere& rhs);
+
+    // sphere enclosing the bounds of all the items, the tighter of merging them in turn and centring on their bounding box
+    extern OSG2VSG_DECLSPEC vsg::sphere computeEnclosingSphere(CullItems::const_iterator begin, CullItems::const_iterator end);
+
+    // build a bounding volume hierarchy of CullGroups over the items, splitting them at the median of the longest axis of their
+    // centres until each group has at most fanOut children. returns the item's own node when there is only one.
+    extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::Node> createCullHierarchy(CullItems items, uint32_t fanOut = 4);
+}
@@ -7,6 +7,9 @@
 #include <osg/Geometry>
 #include <osg/Material>
 
+#include <map>
+#include <mutex>
+
 namespace osg2vsg
 {
     enum GeometryAttributes : uint32_t
@@ -62,10 +65,43 @@ namespace osg2vsg
 
     extern OSG2VSG_DECLSPEC std::pair<VkFilter, VkSamplerMipmapMode> convertToFilterAndMipmapMode(osg::Texture::FilterMode filtermode);
 
-    extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::Sampler> convertToSampler(const osg::Texture* texture);
+    // the maxLod of mipmapped samplers is the number of mipmap levels of the texture's image, once downscaled to maxDimension when non zero,
+    // as the VSG creates that many levels for the image.
+    extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::Sampler> convertToSampler(const osg::Texture* texture, uint32_t maxDimension = 0);
+
+    // thread safe cache of vsg::Sampler keyed by their full state, so textures with the same filter, wrap and anisotropy
+    // settings share a single VkSampler. devices may limit the number of samplers to as few as 4000.
+    class OSG2VSG_DECLSPEC SamplerCache : public vsg::Inherit<vsg::Object, SamplerCache>
+    {
+    public:
+        SamplerCache() {}
+
+        vsg::ref_ptr<vsg::Sampler> getOrCreateSampler(const osg::Texture* texture, uint32_t maxDimension = 0);
+
+        size_t size() const;
+
+    protected:
+        virtual ~SamplerCache() {}
+
+        using SamplerKey = std::vector<uint32_t>;
+
+        mutable std::mutex _mutex;
+        std::map<SamplerKey, vsg::ref_ptr<vsg::Sampler>> _samplers;
+    };
 
     extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::materialValue> convertToMaterialValue(const osg::Material* material);
 
     extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::Command> convertToVsg(osg::Geometry* geometry, uint32_t requiredAttributesMask, GeometryTarget geometryTarget);
 
+    // shallow copy of the geometry with its vertices, normals and tangents transformed by the matrix, so it can be drawn without a transform.
+    // returns null if the vertex array isn't a Vec3Array or Vec3dArray.
+    extern OSG2VSG_DECLSPEC osg::ref_ptr<osg::Geometry> createTransformedGeometry(const osg::Geometry* geometry, const osg::Matrix& matrix);
+
+    // sphere around the centre of the geometry's bounding box, reaching its corners
+    extern OSG2VSG_DECLSPEC vsg::sphere computeBoxBoundingSphere(const osg::Geometry* geometry);
+
+    // near optimal bounding sphere of the geometry's vertices using Ritter's algorithm, or the box sphere if that is smaller
+    // or the bound is computed by a ComputeBoundingBoxCallback, as billboards do.
+    extern OSG2VSG_DECLSPEC vsg::sphere computeBoundingSphere(const osg::Geometry* geometry);
+
 }
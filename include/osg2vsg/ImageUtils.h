@@ -22,12 +22,110 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 #include <osg2vsg/Export.h>
 
+#include <set>
+
 namespace osg2vsg
 {
+    enum MipmapFilter : uint32_t
+    {
+        MIPMAP_FILTER_NONE, // leave mipmap generation to the VSG at compile time
+        MIPMAP_FILTER_BOX,
+        MIPMAP_FILTER_KAISER
+    };
+
+    enum TextureCompression : uint32_t
+    {
+        TEXTURE_COMPRESSION_NONE,
+        TEXTURE_COMPRESSION_FAST, // BC1/BC3 colour maps, bounding box endpoints
+        TEXTURE_COMPRESSION_QUALITY // BC7 colour maps, principal axis endpoints refined by least squares
+    };
+
+    // how a texture is sampled by the shaders, used to select the compressed format
+    enum TextureRole : uint32_t
+    {
+        TEXTURE_ROLE_COLOR, // RGBA colour maps
+        TEXTURE_ROLE_NORMAL, // tangent space normal maps, only x and y are kept when compressed
+        TEXTURE_ROLE_OPACITY // single channel maps sampled from the red channel, such as opacity, ambient and specular maps
+    };
+
+    // settings that control how an osg::Image is converted to vsg::Data
+    struct ImageOptions
+    {
+        MipmapFilter mipmapFilter = MIPMAP_FILTER_NONE;
+        bool sRGB = false; // colour channels are sRGB encoded so should be filtered in linear space
+        TextureCompression compression = TEXTURE_COMPRESSION_NONE;
+        TextureRole role = TEXTURE_ROLE_COLOR;
+        uint32_t maxDimension = 0; // downscale images larger than this, 0 for no limit
+        bool allowRGB = false; // keep 8 bit RGB images as R8G8B8 rather than expanding them to RGBA
+        bool halfFloat = false; // store float images as 16 bit floats, RGB images are expanded to RGBA
+        bool dropOpaqueAlpha = false; // store RGBA images as RGB when every alpha value is 1.0 and allowRGB is set
+        bool releaseSource = false; // move the source image's data into the vsg::Data rather than copying it, leaving the image without data
+    };
+
+    // range of the opacity values an image provides to the shaders, the alpha channel for colour maps and the red channel for opacity maps
+    struct AlphaStatistics
+    {
+        float minAlpha = 1.0f;
+        float maxAlpha = 1.0f;
+        bool binary = true; // every value is either 0.0 or 1.0
+
+        bool opaque() const { return minAlpha>=1.0f; }
+        bool constant() const { return minAlpha==maxAlpha; }
+    };
+
+    // the sampled image formats supported by the target device, used to avoid expanding images to wider formats than needed.
+    // an empty profile assumes only the formats every device supports.
+    struct OSG2VSG_DECLSPEC DeviceFormatProfile
+    {
+        std::set<VkFormat> sampledFormats;
+
+        bool supports(VkFormat format) const { return sampledFormats.count(format)!=0; }
+
+        // true when R8G8B8_UNORM can be used for RGB images
+        bool supportsRGB() const { return supports(VK_FORMAT_R8G8B8_UNORM); }
+
+        // true when the 1, 2 and 4 channel 16 bit float formats can be used for float images
+        bool supportsHalfFloat() const { return supports(VK_FORMAT_R16_SFLOAT) && supports(VK_FORMAT_R16G16_SFLOAT) && supports(VK_FORMAT_R16G16B16A16_SFLOAT); }
+
+        // set the allowRGB and halfFloat options to match the profile
+        void apply(ImageOptions& options) const;
+
+        // query which of the formats the converter can choose between are sampled with optimal tiling by the physical device
+        static DeviceFormatProfile query(VkPhysicalDevice physicalDevice);
+    };
+
     extern OSG2VSG_DECLSPEC VkFormat convertGLImageFormatToVulkan(GLenum dataType, GLenum pixelFormat);
 
     extern OSG2VSG_DECLSPEC osg::ref_ptr<osg::Image> formatImageToRGBA(const osg::Image* image);
 
+    // generate the full mipmap chain for 2D GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT and GL_FLOAT images, other images are returned unchanged
+    extern OSG2VSG_DECLSPEC osg::ref_ptr<osg::Image> generateMipmaps(const osg::Image* image, MipmapFilter filter, bool sRGB);
+
+    // halve the dimensions of an uncompressed 2D image until neither exceeds maxDimension, any mipmaps are discarded. other images are returned unchanged
+    extern OSG2VSG_DECLSPEC osg::ref_ptr<osg::Image> downscaleImage(const osg::Image* image, uint32_t maxDimension, MipmapFilter filter, bool sRGB);
+
+    // convert a GL_FLOAT image, and any mipmaps, to GL_HALF_FLOAT, rounding to nearest even. other images are returned unchanged
+    extern OSG2VSG_DECLSPEC osg::ref_ptr<osg::Image> convertToHalfFloat(const osg::Image* image);
+
+    // scan the level 0 opacity values of an uncompressed GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_FLOAT image.
+    // images without an alpha channel are opaque, other images are assumed to cover the full range of values
+    extern OSG2VSG_DECLSPEC AlphaStatistics computeAlphaStatistics(const osg::Image* image, TextureRole role);
+
+    // compress a 2D GL_UNSIGNED_BYTE image, and any mipmaps, to the BC format suited to its role. returns null if the image can't be compressed
+    extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::Data> compressImage(const osg::Image* image, TextureRole role, TextureCompression compression);
+
+    // true when a normal map converted with this compression may only keep x and y, as BC5 and two channel images do, so z has
+    // to be reconstructed when shading. maps that turn out to keep z are still shaded correctly from x and y.
+    extern OSG2VSG_DECLSPEC bool normalMapKeepsOnlyXY(const osg::Image* image, TextureCompression compression);
+
     extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::Data> convertToVsg(const osg::Image* image);
+
+    // the image is left untouched, its data is copied unless it has to be reformatted anyway, unless options.releaseSource is set
+    // in which case data allocated with new[] is moved and the image is left with no data, so only set it for images nothing else will read.
+    extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::Data> convertToVsg(const osg::Image* image, const ImageOptions& options);
+
+    // convert the image, moving its data into the returned vsg::Data without a copy when the caller's reference was the only one
+    // and the data was allocated with new[], in which case the image is left empty. otherwise the data is copied and the image is left untouched.
+    extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::Data> moveToVsg(osg::ref_ptr<osg::Image> image, const ImageOptions& options = {});
 }
 
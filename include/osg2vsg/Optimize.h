@@ -30,4 +30,29 @@ namespace osg2vsg
         void optimize();
 
     };
+
+    // pack small compatible textures, those with matching formats and sampler state, into shared atlases and rewrite
+    // the texcoords, so statesets that only differed by texture become identical and share one descriptor set once converted.
+    // run before osgUtil::Optimizer's SHARE_DUPLICATE_STATE so the statesets now referencing the same atlas are merged.
+    class OptimizeOsgTextureAtlases
+    {
+    public:
+        OptimizeOsgTextureAtlases(unsigned int in_maxAtlasSize = 2048);
+
+        struct Counts
+        {
+            size_t numTexturedStateSets = 0; // unique textured statesets, each becomes a descriptor set bind
+            size_t numTextures = 0;
+        };
+
+        unsigned int maxAtlasSize;
+        Counts before;
+        Counts after;
+
+        static Counts count(osg::Node* scene);
+
+        void optimize(osg::Node* scene);
+
+        void report(std::ostream& out) const;
+    };
 }
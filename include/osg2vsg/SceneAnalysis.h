@@ -4,6 +4,7 @@
 
 #include <osg/Geometry>
 
+#include <set>
 #include <typeindex>
 
 
@@ -26,7 +27,43 @@ namespace osg2vsg
         }
 
 
+        enum MemoryCategory
+        {
+            VERTEX_DATA,
+            INDEX_DATA,
+            TEXTURE_DATA,
+            UNIFORM_DATA,
+            DESCRIPTOR_DATA,
+            NUM_MEMORY_CATEGORIES
+        };
+
+        static const char* getCategoryName(MemoryCategory category);
+
+        // bytes held in CPU memory by the osg or vsg copy of the scene, and for vsg scenes an estimate of the GPU memory it needs once compiled
+        struct MemoryFootprint
+        {
+            uint64_t cpuBytes[NUM_MEMORY_CATEGORIES] = {};
+            uint64_t gpuBytes[NUM_MEMORY_CATEGORIES] = {};
+
+            uint64_t totalCpuBytes() const;
+            uint64_t totalGpuBytes() const;
+        };
+
+        // whole scene, data shared between several parts of it counted once
+        MemoryFootprint memory;
+
+        // per GraphicsPipeline in the order first drawn, data shared between pipelines counted against each. data bound outside any pipeline is under nullptr
+        std::vector<std::pair<const void*, MemoryFootprint>> pipelineMemory;
+
+        // add the bytes of the data object unless already counted, in the scene and in the pipeline
+        void addMemory(const void* pipeline, const void* data, MemoryCategory category, uint64_t cpuBytes, uint64_t gpuBytes);
+
         void print(std::ostream& out);
+        void printMemory(std::ostream& out);
+
+    protected:
+        std::set<const void*> _countedData;
+        std::map<const void*, std::pair<size_t, std::set<const void*>>> _pipelineCountedData;
     };
 
 
@@ -53,10 +90,28 @@ namespace osg2vsg
         VsgSceneAnalysis();
         VsgSceneAnalysis(SceneStats* sceneStats);
 
+        // estimated bytes of descriptor pool memory per descriptor, and the alignment uniform and storage buffers are allocated at
+        uint64_t descriptorSize = 32;
+        uint64_t uniformAlignment = 256;
+
         void apply(const vsg::Object& object) override;
         void apply(const vsg::Geometry& geometry) override;
+        void apply(const vsg::VertexIndexDraw& vid) override;
+        void apply(const vsg::Commands& commands) override;
+        void apply(const vsg::BindVertexBuffers& bvb) override;
+        void apply(const vsg::BindIndexBuffer& bib) override;
         void apply(const vsg::StateGroup& stategroup) override;
-        //void apply(const vsg::Commands& commands) override;
+        void apply(const vsg::BindGraphicsPipeline& bindPipeline) override;
+        void apply(const vsg::DescriptorSet& descriptorSet) override;
+        void apply(const vsg::DescriptorImage& descriptorImage) override;
+        void apply(const vsg::DescriptorBuffer& descriptorBuffer) override;
+
+    protected:
+        void addData(const vsg::Data* data, SceneStats::MemoryCategory category);
+
+        // pipeline the subgraph being traversed is drawn with, and the descriptors counted in the descriptor set being traversed
+        const vsg::GraphicsPipeline* _pipeline = nullptr;
+        uint32_t _numDescriptors = 0;
     };
 
 }
@@ -4,6 +4,8 @@
 
 #include <iostream>
 #include <chrono>
+#include <memory>
+#include <unordered_map>
 
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
@@ -13,6 +15,12 @@
 
 #include <osg2vsg/ShaderUtils.h>
 #include <osg2vsg/GeometryUtils.h>
+#include <osg2vsg/ImageUtils.h>
+#include <osg2vsg/WorkerPool.h>
+#include <osg2vsg/TextureRegistry.h>
+#include <osg2vsg/CullHierarchy.h>
+#include <osg2vsg/ViewSorter.h>
+#include <osg2vsg/ConversionObserver.h>
 
 namespace osg2vsg
 {
@@ -20,13 +28,17 @@ namespace osg2vsg
     {
         vsg::ref_ptr<ShaderCompiler> shaderCompiler = ShaderCompiler::create();
 
-        using Key = std::tuple<uint32_t, uint32_t, std::string, std::string>;
+        using Key = std::tuple<uint32_t, uint32_t, std::string, std::string, const vsg::PipelineLayout*>;
         using PipelineMap = std::map<Key, vsg::ref_ptr<vsg::BindGraphicsPipeline>>;
 
         std::mutex mutex;
         PipelineMap pipelineMap;
 
-        vsg::ref_ptr<vsg::BindGraphicsPipeline> getOrCreateBindGraphicsPipeline(uint32_t shaderModeMask, uint32_t geometryMask, const std::string& vertShaderPath = "", const std::string& fragShaderPath = "");
+        // pipelines are created with a layout matching their shader modes unless given the pipelineLayout to share, as BINDLESS_TEXTURES pipelines are
+        vsg::ref_ptr<vsg::BindGraphicsPipeline> getOrCreateBindGraphicsPipeline(uint32_t shaderModeMask, uint32_t geometryMask, const std::string& vertShaderPath = "", const std::string& fragShaderPath = "", vsg::ref_ptr<vsg::PipelineLayout> pipelineLayout = {});
+
+        // remove the pipelines created with a shared pipelineLayout that is being replaced
+        void removePipelines(const vsg::PipelineLayout* pipelineLayout);
     };
 
     struct BuildOptions : public vsg::Inherit<vsg::Object, BuildOptions>
@@ -36,6 +48,39 @@ namespace osg2vsg
         bool useBindDescriptorSet = true;
         bool billboardTransform = false;
 
+        // build a bounding volume hierarchy of CullGroups, with at most cullHierarchyFanOut children each, over the culled leaves
+        // and transforms of each state group, rather than placing them all directly under one group
+        bool buildCullHierarchy = false;
+        uint32_t cullHierarchyFanOut = 4;
+
+        // compute cull spheres from the vertices of each geometry rather than from its bounding box, which can be up to 1.7x larger
+        bool tightBoundingSpheres = true;
+
+        // apply the matrix of geometries only ever drawn under one transform to their vertices, normals and tangents, drawing them
+        // without a MatrixTransform. geometries drawn under several matrices, and billboards, keep their transforms.
+        bool flattenStaticTransforms = false;
+
+        // place each blended leaf and transform, with its own pipeline and descriptor set binds, in one bin group that
+        // SceneBuilder::viewSorter sorts back to front each frame, rather than drawing blended geometry in pipeline order
+        bool depthSortTransparent = false;
+
+        // register the children of each opaque state group with SceneBuilder::viewSorter to be drawn coarsely front to back.
+        // not applied to state groups with a cull hierarchy, whose CullGroups already keep nearby geometry together
+        bool frontToBackOpaque = false;
+
+        // gather the materials of every state into one storage buffer, bound alongside each pipeline reading it, with each state pushing
+        // the index of its material, so states that only differ in material share a descriptor set. MATERIAL_BUFFER pipelines push
+        // the index at offset 128, so materials fall back to per state uniforms unless maxPushConstantsSize allows for it.
+        bool materialBuffer = false;
+
+        // maxPushConstantsSize of the target device, defaults to the 128 bytes Vulkan guarantees
+        uint32_t maxPushConstantsSize = 128;
+
+        // read the texture maps of every state from one scene wide array of textures, indexed by texture indices stored in the material buffer,
+        // so no state binds a descriptor set of its own and all the pipelines share one layout. implies materialBuffer, and the device needs
+        // the descriptor indexing features that supportsBindlessTextures() checks for. falls back like materialBuffer.
+        bool bindlessTextures = false;
+
         GeometryTarget geometryTarget = VSG_VERTEXINDEXDRAW;
 
         uint32_t supportedGeometryAttributes = GeometryAttributes::ALL_ATTS;
@@ -48,7 +93,57 @@ namespace osg2vsg
 
         vsg::Path extension = "vsgb";
 
+        // number of threads to use when converting textures, 1 converts them serially on the calling thread
+        uint32_t numThreads = 1;
+
+        // optional WorkerPool to share between SceneBuilders, if not assigned one is created on demand when numThreads>1
+        vsg::ref_ptr<WorkerPool> workerPool;
+
+        // depth at which SceneBuilder::traverseScene() splits the osg scene into subgraphs to traverse concurrently, 0 traverses it serially.
+        // the subgraph results are merged in traversal order so the grouping matches that of a serial traversal
+        // subgraphs holding billboards converted with SHADER_TRANSLATE modify their drawables, so are traversed on the calling thread
+        uint32_t traversalPartitionDepth = 0;
+
+        // optional observer told of each conversion phase as it begins and ends, and able to cancel the conversion
+        vsg::ref_ptr<ConversionObserver> observer;
+
+        // filter used to generate mipmaps on the CPU for textures that require them, MIPMAP_FILTER_NONE leaves it to the VSG
+        MipmapFilter mipmapFilter = MIPMAP_FILTER_NONE;
+        bool sRGBDiffuseTextures = true;
+
+        // compress uncompressed textures to BC formats, textures requiring mipmaps have them generated on the CPU first
+        TextureCompression textureCompression = TEXTURE_COMPRESSION_NONE;
+
+        // limits on texture memory, textures are downscaled to fit starting with those that have the most texels
+        // relative to their importance, estimated from the size of the geometry they cover and its texcoord density. 0 for no limit.
+        // textures whose texcoords can't be measured are only limited by maxTextureDimension
+        uint64_t textureMemoryBudget = 0;
+        uint32_t maxTextureDimension = 0;
+
+        // on screen size, in pixels, of geometry spanning the whole scene, used to estimate the texels each texture needs
+        double referenceScreenSize = 2048.0;
+
+        // pack small textures into atlases before conversion so more statesets can share descriptor sets, 0 disables atlasing
+        uint32_t maxTextureAtlasSize = 0;
+
+        // scan texture, material and vertex colour alpha of blended states, drawing them as opaque or alpha tested geometry when the
+        // alpha values allow it, and dropping the alpha channel of opaque diffuse textures when the formatProfile supports RGB
+        bool analyseOpacity = true;
+
+        // move the data of the osg scene's images into the converted textures rather than copying it, leaving the images without data.
+        // only images referenced by a single texture in one unit are moved. set when the osg scene isn't used after conversion, so not
+        // when it will be reconverted with updateVSG() or written out with createOSG()
+        bool releaseSourceImages = false;
+
+        // sampled formats supported by the target device, RGB and float textures are only stored in narrower formats the profile lists.
+        // the converter usually runs before a device exists, so applications fill it in from DeviceFormatProfile::query() or their own knowledge of the target
+        DeviceFormatProfile formatProfile;
+
+        // optional registry that shares textures with identical contents and samplers between SceneBuilders
+        vsg::ref_ptr<TextureRegistry> textureRegistry;
+
         vsg::ref_ptr<PipelineCache> pipelineCache = PipelineCache::create();
+        vsg::ref_ptr<SamplerCache> samplerCache = SamplerCache::create();
     };
 
     class SceneBuilderBase
@@ -62,43 +157,157 @@ namespace osg2vsg
         using StateStack = std::vector<osg::ref_ptr<osg::StateSet>>;
         using StateSets = std::set<StateStack>;
         using StatePair = std::pair<osg::ref_ptr<osg::StateSet>, osg::ref_ptr<osg::StateSet>>;
-        using StateMap = std::map<StateStack, StatePair>;
+
+        // node in the trie of state stacks, one for each distinct sequence of statesets pushed during traversal,
+        // so the StatePair of a stack is computed once and then found by following pushStateSet()/popStateSet()
+        struct StateNode
+        {
+            StateNode* parent = nullptr;
+            osg::ref_ptr<osg::StateSet> stateset;
+            osg::ref_ptr<osg::StateSet> combined; // the statesets from the root to this node merged in order, computed on demand
+            StatePair statePair;
+            std::unordered_map<const osg::StateSet*, StateNode*> children;
+        };
         using GeometriesMap = std::map<const osg::Geometry*, vsg::ref_ptr<vsg::Command>>;
 
 
-        using TexturesMap = std::map<const osg::Texture*, vsg::ref_ptr<vsg::DescriptorImage>>;
+        // textures are keyed by unit as well, as the unit determines the binding and how the image is converted
+        using TextureUnitPair = std::pair<const osg::Texture*, uint32_t>;
+        using TexturesMap = std::map<TextureUnitPair, vsg::ref_ptr<vsg::DescriptorImage>>;
 
-        struct UniqueStateSet
+        // the parts of a StateSet that computeStatePair() splits it into, the program state holds the modes, defines and programs
+        // and the data state the remaining attributes, texture attributes and uniforms
+        enum StatePart
         {
-            bool operator() ( const osg::ref_ptr<osg::StateSet>& lhs, const osg::ref_ptr<osg::StateSet>& rhs) const
-            {
-                if (!lhs) return true;
-                if (!rhs) return false;
-                return lhs->compare(*rhs)<0;
-            }
+            WHOLE_STATE,
+            PROGRAM_STATE,
+            DATA_STATE
         };
 
-        using UniqueStats = std::set<osg::ref_ptr<osg::StateSet>, UniqueStateSet>;
+        // unique statesets bucketed by computeStateHash(), so lookups only compare the few statesets with the same hash
+        using UniqueStateTable = std::unordered_map<uint64_t, std::vector<osg::ref_ptr<osg::StateSet>>>;
 
         vsg::ref_ptr<const BuildOptions> buildOptions = BuildOptions::create();
 
         uint32_t nodeShaderModeMasks = ShaderModeMask::NONE;
 
         StateStack statestack;
-        StateMap stateMap;
-        UniqueStats uniqueStateSets;
+        StateNode rootStateNode;
+        StateNode* currentStateNode = &rootStateNode;
+        std::vector<std::unique_ptr<StateNode>> stateNodes; // all nodes but the root, in the order they were created
+        UniqueStateTable uniqueStateTable;
         TexturesMap texturesMap;
+        std::mutex texturesMutex; // guards texturesMap in convertToVsgTexture(), which createVSG() calls from several threads
+        std::map<const osg::Texture*, uint32_t> textureMaxDimensions;
+
+        // alpha statistics are recomputed when the image's modification count changes, the reference stops another image reusing the address
+        struct ImageAlphaStatistics
+        {
+            osg::ref_ptr<const osg::Image> image;
+            unsigned int modifiedCount = 0;
+            AlphaStatistics statistics;
+        };
+        std::map<std::pair<const osg::Image*, TextureRole>, ImageAlphaStatistics> alphaStatisticsMap;
+
+        // alpha statistics of vertex colour arrays, likewise recomputed when the array's modification count changes
+        struct ArrayAlphaStatistics
+        {
+            osg::ref_ptr<const osg::Array> array;
+            unsigned int modifiedCount = 0;
+            AlphaStatistics statistics;
+        };
+        std::map<const osg::Array*, ArrayAlphaStatistics> colorAlphaStatisticsMap;
+        std::mutex alphaStatisticsMutex; // guards alphaStatisticsMap and colorAlphaStatisticsMap while subgraphs are traversed concurrently
+
+        // the builder whose alpha statistics the builders traversing its subgraphs share, so each image is only scanned once
+        SceneBuilderBase* alphaStatisticsOwner = nullptr;
+
+        // textures converted by the last createVSG() with the signature of the image and sampler they were converted from, for updateVSG() to reuse
+        struct ConvertedTexture
+        {
+            osg::ref_ptr<const osg::Texture> texture;
+            uint64_t signature = 0;
+            vsg::ref_ptr<vsg::DescriptorImage> descriptorImage;
+        };
+        std::map<TextureUnitPair, ConvertedTexture> convertedTextures;
+
+        // objects to reconvert on the next updateVSG() whatever their signatures say, see dirty()
+        std::set<const osg::Object*> dirtyObjects;
+
+        // conversions reused from the previous createVSG() and created afresh by the last one
+        struct ReconversionStats
+        {
+            uint32_t numReusedGeometries = 0;
+            uint32_t numConvertedGeometries = 0;
+            uint32_t numReusedTextures = 0;
+            uint32_t numConvertedTextures = 0;
+            uint32_t numReusedDescriptorSets = 0;
+            uint32_t numCreatedDescriptorSets = 0;
+            uint32_t numReusedStateGraphs = 0;
+            uint32_t numCreatedStateGraphs = 0;
+        };
+        ReconversionStats reconversionStats;
+
+        vsg::ref_ptr<WorkerPool> workerPool;
         bool writeToFileProgramAndDataSetSets = false;
 
+        WorkerPool* getOrCreateWorkerPool();
+
+        // true once the BuildOptions::observer has cancelled the conversion
+        bool cancelled() const { return buildOptions->observer && buildOptions->observer->cancelled(); }
+
+        // structural hash of the modes, attributes, texture modes and attributes, uniforms and defines in the given part of the stateset.
+        // attributes and uniforms are hashed by pointer, matching osg::StateSet::compare(), so the hash of a part equals that of the
+        // StateSet that would be created from it.
+        static uint64_t computeStateHash(const osg::StateSet& stateset, StatePart part = WHOLE_STATE);
+
+        // return true if the given part of the stateset has the same contents as the unique stateset
+        static bool equalStatePart(const osg::StateSet& stateset, StatePart part, const osg::StateSet& unique);
+
+        // create a new StateSet holding just the given part of the stateset
+        static osg::ref_ptr<osg::StateSet> createStatePart(const osg::StateSet& stateset, StatePart part);
+
         osg::ref_ptr<osg::StateSet> uniqueState(osg::ref_ptr<osg::StateSet> stateset, bool programStateSet);
 
+        // probe the uniqueStateTable for the given part of the stateset, only creating a StateSet for it when there is no match
+        osg::ref_ptr<osg::StateSet> getOrCreateUniqueStatePart(const osg::StateSet& stateset, StatePart part);
+
         StatePair computeStatePair(osg::StateSet* stateset);
         StatePair& getStatePair();
 
+        void pushStateSet(osg::StateSet& stateset);
+        void popStateSet();
+
+        osg::StateSet* getCombinedStateSet(StateNode* node);
+
         // core VSG style usage
-        vsg::ref_ptr<vsg::DescriptorImage> convertToVsgTexture(const osg::Texture* osgtexture);
+        vsg::ref_ptr<vsg::DescriptorImage> createVsgTexture(const osg::Texture* osgtexture, uint32_t unit, bool releaseImage = false) const;
+        vsg::ref_ptr<vsg::DescriptorImage> convertToVsgTexture(const osg::Texture* osgtexture, uint32_t unit);
+
+        // force the geometry, texture or image to be reconverted by the next updateVSG(). only needed for edits that signatures don't see, as array,
+        // primitive set and image changes show in their modification counts once dirtied, and samplers, materials and statesets are compared by value
+        void dirty(const osg::Object* object) { if (object) dirtyObjects.insert(object); }
+        bool isDirty(const osg::Object* object) const { return object && dirtyObjects.count(object)>0; }
+
+        // signature of the image, its modification count, the sampler and the conversion settings the texture is converted with
+        uint64_t computeTextureSignature(const osg::Texture* osgtexture, uint32_t unit) const;
+
+        // convert all the textures referenced by the state nodes, or the given statesets, into the texturesMap, in parallel when a WorkerPool is available.
+        // textures in convertedTextures whose signature is unchanged are reused rather than converted again.
+        // with BuildOptions::releaseSourceImages the images are moved, so the textures must be converted here before the images are emptied
+        void convertTextures();
+        void convertTextures(const std::vector<osg::ref_ptr<osg::StateSet>>& statesets);
 
         vsg::ref_ptr<vsg::DescriptorSet> createVsgStateSet(vsg::ref_ptr<vsg::DescriptorSetLayout> descriptorSetLayout, const osg::StateSet* stateset, uint32_t shaderModeMask);
+
+        // return the shaderModeMask with BLEND removed when the alpha of the textures, material and vertex colours is always 1.0,
+        // or replaced by ALPHA_TEST when it is only ever 0.0 or 1.0. the stateset is the data state holding the textures and material.
+        uint32_t classifyOpacity(const osg::StateSet* stateset, const osg::Geometry* geometry, uint32_t shaderModeMask);
+        AlphaStatistics getAlphaStatistics(const osg::Image* image, TextureRole role);
+        AlphaStatistics getAlphaStatistics(const osg::Array* colors);
+
+        // return the shaderModeMask with NORMAL_MAP_XY added when the normal map may be converted without z, such as to BC5
+        uint32_t classifyNormalMap(const osg::StateSet* stateset, uint32_t shaderModeMask) const;
     };
 
     class SceneBuilder : public osg::NodeVisitor, public SceneBuilderBase
@@ -112,33 +321,175 @@ namespace osg2vsg
             SceneBuilderBase(options) {}
 
         using Geometries = std::vector<osg::ref_ptr<osg::Geometry>>;
-        using StateGeometryMap = std::map<osg::ref_ptr<osg::StateSet>, Geometries>;
-        using TransformGeometryMap = std::map<osg::Matrix, Geometries>;
         using MatrixStack = std::vector<osg::Matrixd>;
 
+        // the grouping "maps" are flat vectors of key/value pairs in order of first use, built from the geometryRecords by groupGeometries()
+        using StateGeometryMap = std::vector<std::pair<osg::ref_ptr<osg::StateSet>, Geometries>>;
+        using TransformGeometryMap = std::vector<std::pair<osg::Matrix, Geometries>>;
+
         struct TransformStatePair
         {
-            std::map<osg::Matrix, StateGeometryMap> matrixStateGeometryMap;
-            std::map<osg::ref_ptr<osg::StateSet>, TransformGeometryMap> stateTransformMap;
+            std::vector<std::pair<osg::Matrix, StateGeometryMap>> matrixStateGeometryMap;
+            std::vector<std::pair<osg::ref_ptr<osg::StateSet>, TransformGeometryMap>> stateTransformMap;
         };
 
         using Masks = std::pair<uint32_t, uint32_t>;
-        using MasksTransformStateMap = std::map<Masks, TransformStatePair>;
+        using MasksTransformStateMap = std::vector<std::pair<Masks, TransformStatePair>>;
 
-        using ProgramTransformStateMap = std::map<osg::ref_ptr<osg::StateSet>, TransformStatePair>;
+        using ProgramTransformStateMap = std::vector<std::pair<osg::ref_ptr<osg::StateSet>, TransformStatePair>>;
+
+        // one record per geometry visited, with its matrix and states interned as indices into matrices and states
+        struct GeometryRecord
+        {
+            osg::ref_ptr<osg::Geometry> geometry;
+            uint32_t programStateId;
+            uint32_t dataStateId;
+            uint32_t matrixId;
+            Masks masks;
+        };
+
+        struct MatrixHash
+        {
+            size_t operator() (const osg::Matrix& matrix) const;
+        };
 
         MatrixStack matrixstack;
+        std::vector<uint32_t> matrixIdStack;
+
+        std::vector<GeometryRecord> geometryRecords;
+        std::vector<osg::Matrix> matrices;
+        std::unordered_map<osg::Matrix, uint32_t, MatrixHash> matrixIds;
+        std::vector<osg::ref_ptr<osg::StateSet>> states;
+        std::unordered_map<const osg::StateSet*, uint32_t> stateIds;
+
         ProgramTransformStateMap programTransformStateMap;
         MasksTransformStateMap masksTransformStateMap;
         GeometriesMap geometriesMap;
 
+        // geometries converted by the last createVSG() with their matrix, given by its id, applied to their vertex data
+        std::unordered_map<const osg::Geometry*, uint32_t> flattenedGeometries;
+
+        // bounding spheres of the geometries converted by the last createVSG(), and the average ratio of their volume to that
+        // of the spheres around the geometries' bounding boxes
+        std::unordered_map<const osg::Geometry*, vsg::sphere> boundingSpheres;
+        double averageSphereVolumeRatio = 1.0;
+
+        // estimated memory of the textures of the last createVSG() after downscaling them for BuildOptions::textureMemoryBudget,
+        // which it exceeds when the budget couldn't be met. 0 when neither texture limit is set
+        uint64_t estimatedTextureMemory = 0;
+
+        // groups of the last createVSG() to reorder for the view each frame, null when neither depthSortTransparent nor frontToBackOpaque is set
+        vsg::ref_ptr<ViewSorter> viewSorter;
+
+        // number of materials in the material buffer and of per state descriptor sets created by the last createVSG()
+        uint32_t numBufferedMaterials = 0;
+        uint32_t numStateDescriptorSets = 0;
+
+        // number of textures in the scene wide texture array of the last createVSG() with BuildOptions::bindlessTextures
+        uint32_t numBindlessTextures = 0;
+
+        // number of elements of the texture array in the bindless layout, the power of two numBindlessTextures is rounded up to
+        uint32_t bindlessTextureCapacity = 0;
+
+        // conversions of the last createVSG() kept for updateVSG() to reuse, each with the signature of what it was converted from.
+        // the osg references stop other objects reusing the addresses the conversions are keyed on while they are cached
+        struct ConvertedGeometry
+        {
+            osg::ref_ptr<const osg::Geometry> geometry;
+            uint64_t signature = 0;
+            vsg::ref_ptr<vsg::Command> command;
+            vsg::sphere bound;
+            float boxRadius = 0.0f;
+        };
+        std::unordered_map<const osg::Geometry*, ConvertedGeometry> convertedGeometries;
+
+        // descriptor set binds and subgraphs of each data state drawn with a pipeline
+        using StateKey = std::pair<const vsg::BindGraphicsPipeline*, const osg::StateSet*>;
+
+        struct ConvertedState
+        {
+            osg::ref_ptr<const osg::StateSet> stateset;
+            uint64_t signature = 0;
+            vsg::ref_ptr<vsg::StateCommand> bindDescriptorSet;
+        };
+        std::map<StateKey, ConvertedState> convertedStates;
+
+        struct ConvertedStateGraph
+        {
+            osg::ref_ptr<const osg::StateSet> stateset;
+            uint64_t signature = 0;
+            vsg::ref_ptr<vsg::Node> node;
+            CullItems items;
+            bool depthSorted = false;
+            vsg::ref_ptr<vsg::Group> frontToBackGroup;
+        };
+        std::map<StateKey, ConvertedStateGraph> convertedStateGraphs;
+
+        // the material buffer, the push constants selecting each of its materials and the layout shared by bindless pipelines
+        std::vector<uint32_t> bufferedMaterialValues;
+        vsg::SamplerImages bufferedSamplerImages;
+        vsg::ref_ptr<vsg::PipelineLayout> materialPipelineLayout;
+        vsg::ref_ptr<vsg::DescriptorSet> materialDescriptorSet;
+        vsg::ref_ptr<vsg::StateCommand> bindMaterialBuffer;
+        std::vector<vsg::ref_ptr<vsg::StateCommand>> materialPushConstants;
+        vsg::ref_ptr<vsg::PipelineLayout> bindlessPipelineLayout;
+
+        // root returned by updateVSG(), the same Group every call with its child replaced by the latest conversion
+        vsg::ref_ptr<vsg::Group> updatedRoot;
+
+        // milliseconds spent in each phase of the last optimizeAndConvertToVsg() or updateVSG(), in the order they ran
+        std::vector<std::pair<std::string, double>> phaseTimings;
+        std::string currentPhase;
+        std::chrono::steady_clock::time_point phaseStart;
+
+        uint32_t internMatrix(const osg::Matrix& matrix);
+        uint32_t internState(osg::StateSet* stateset);
+
+        // rebuild programTransformStateMap and masksTransformStateMap from the geometryRecords
+        void groupGeometries();
+
+        // traverse the scene, serially or split into subgraphs traversed on the WorkerPool threads when BuildOptions::traversalPartitionDepth is set
+        void traverseScene(osg::Node& scene);
+
+        // clear the geometry records, interned matrices and states and the state trie of the last traversal, so the scene can be traversed again.
+        // the unique states are kept so states that haven't changed are found as the same StateSets
+        void resetTraversal();
+
+        // append the geometry records of a SceneBuilder that traversed the next subgraph of the scene, interning its matrices and states
+        void mergeSubgraph(SceneBuilder& subgraphBuilder);
+
         osg::ref_ptr<osg::Node> createStateGeometryGraphOSG(StateGeometryMap& stateGeometryMap);
         osg::ref_ptr<osg::Node> createTransformGeometryGraphOSG(TransformGeometryMap& transformGeometryMap);
         osg::ref_ptr<osg::Node> createOSG();
 
-        vsg::ref_ptr<vsg::Node> createTransformGeometryGraphVSG(TransformGeometryMap& transformGeometryMap, vsg::Paths& searchPaths, uint32_t requiredGeomAttributesMask);
+        vsg::sphere getBoundingSphere(const osg::Geometry* geometry) const;
+
+        // when sortItems is provided the leaves and transforms are appended to it with their bounds, without a cull hierarchy, and null is returned
+        vsg::ref_ptr<vsg::Node> createTransformGeometryGraphVSG(TransformGeometryMap& transformGeometryMap, vsg::Paths& searchPaths, uint32_t requiredGeomAttributesMask, CullItems* sortItems = nullptr);
+
+        // convert the grouped geometries to a VSG scene graph, converting textures, pipelines, geometries and state groups in parallel when a WorkerPool is available.
+        // with reusePreviousConversions the geometries, textures, descriptor sets and state subgraphs of the previous call whose signatures are unchanged are reused
+        vsg::ref_ptr<vsg::Node> createVSG(vsg::Paths& searchPaths, bool reusePreviousConversions = false);
+
+        // retraverse the scene after it has been edited and convert it again, only reconverting the geometries, textures and states whose osg sources
+        // have changed. vsg objects for everything unchanged are the ones in the previous conversion, so only new objects need compiling. the returned
+        // Group is the same one every call, with its child replaced, so it can be left in the viewer's scene graph. the scene isn't optimized first.
+        vsg::ref_ptr<vsg::Node> updateVSG(osg::Node& scene, vsg::Paths& searchPaths);
+
+        // signature of the arrays, primitive sets and flattening matrix the geometry is converted from, with the attributes it is converted with
+        uint64_t computeGeometrySignature(const osg::Geometry* geometry, uint32_t geometryMask) const;
 
-        vsg::ref_ptr<vsg::Node> createVSG(vsg::Paths& searchPaths);
+        // signature of the material and converted textures the descriptor set of the stateset is created from
+        uint64_t computeStateSignature(const osg::StateSet* stateset, uint32_t shaderModeMask) const;
+
+        // time a phase into phaseTimings and pass it to the BuildOptions::observer, endPhase() returns false if the conversion has been cancelled
+        void beginPhase(const char* phase);
+        bool endPhase(const PhaseStats& stats = {});
+
+        void printPhaseTimings(std::ostream& out) const;
+
+        // assign textureMaxDimensions so the textures fit within BuildOptions::textureMemoryBudget and maxTextureDimension
+        void computeTextureMaxDimensions();
 
         void apply(osg::Node& node);
         void apply(osg::Group& group);
@@ -146,9 +497,6 @@ namespace osg2vsg
         void apply(osg::Billboard& billboard);
         void apply(osg::Geometry& geometry);
 
-        void pushStateSet(osg::StateSet& stateset);
-        void popStateSet();
-
         void pushMatrix(const osg::Matrix& matrix);
         void popMatrix();
 
@@ -23,7 +23,11 @@ namespace osg2vsg
         NORMAL_MAP = 128,
         SPECULAR_MAP = 256,
         SHADER_TRANSLATE = 512,
-        ALL_SHADER_MODE_MASK = LIGHTING | MATERIAL | BLEND | BILLBOARD | DIFFUSE_MAP | OPACITY_MAP | AMBIENT_MAP | NORMAL_MAP | SPECULAR_MAP | SHADER_TRANSLATE
+        ALPHA_TEST = 1024,
+        MATERIAL_BUFFER = 2048, // MATERIAL read from the scene wide storage buffer in set 0, indexed by a push constant
+        BINDLESS_TEXTURES = 4096, // texture maps read from the scene wide texture array in set 0, indexed by the material buffer
+        NORMAL_MAP_XY = 8192, // NORMAL_MAP may only hold x and y, such as BC5, so z is reconstructed in the shader
+        ALL_SHADER_MODE_MASK = LIGHTING | MATERIAL | BLEND | BILLBOARD | DIFFUSE_MAP | OPACITY_MAP | AMBIENT_MAP | NORMAL_MAP | SPECULAR_MAP | SHADER_TRANSLATE | ALPHA_TEST | MATERIAL_BUFFER | BINDLESS_TEXTURES | NORMAL_MAP_XY
     };
 
     // taken from osg fbx plugin
@@ -37,11 +41,22 @@ namespace osg2vsg
         NORMAL_TEXTURE_UNIT,
         SPECULAR_TEXTURE_UNIT,
         SHININESS_TEXTURE_UNIT,
-        MATERIAL_BINDING = 10 // same value as used in the shader
+        MATERIAL_BINDING = 10, // same value as used in the shader
+        TEXTURE_ARRAY_BINDING = 11 // binding of the BINDLESS_TEXTURES array, after the material buffer as variable sized arrays have to be last
     };
 
+    // offset of the material index push constant read by MATERIAL_BUFFER shaders, following the projection and modelview matrices
+    const uint32_t MATERIAL_INDEX_PUSH_CONSTANT_OFFSET = 128;
+
     extern OSG2VSG_DECLSPEC uint32_t calculateShaderModeMask(const osg::StateSet* stateSet);
 
+    // whether a device with this maxPushConstantsSize can push the material index of MATERIAL_BUFFER pipelines
+    inline bool supportsMaterialBuffer(uint32_t maxPushConstantsSize) { return maxPushConstantsSize >= MATERIAL_INDEX_PUSH_CONSTANT_OFFSET + sizeof(uint32_t); }
+
+    // whether the device supports the descriptor indexing features, and limits, that BINDLESS_TEXTURES shaders over numTextures textures require.
+    // the instance must be created for Vulkan 1.1 or later, and the application has to enable the features when creating its device.
+    extern OSG2VSG_DECLSPEC bool supportsBindlessTextures(VkPhysicalDevice physicalDevice, uint32_t numTextures = 0);
+
     // read a glsl file and inject defines based on shadermodemask and geometryatts
     extern OSG2VSG_DECLSPEC std::string readGLSLShader(const std::string& filename, const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes);
 
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+#include <osg2vsg/ImageUtils.h>
+#include <osg2vsg/GeometryUtils.h>
+
+#include <vsg/all.h>
+
+#include <osg/Texture>
+
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace osg2vsg
+{
+    // thread safe registry of converted textures keyed by the contents of their images, so the same image loaded by
+    // several files, or duplicated by exporters, is only converted and uploaded once. can be shared between SceneBuilders via BuildOptions.
+    class OSG2VSG_DECLSPEC TextureRegistry : public vsg::Inherit<vsg::Object, TextureRegistry>
+    {
+    public:
+        TextureRegistry() {}
+
+        // 64 bit hash of the image's dimensions, format and data, including mipmaps, combined with the conversion settings.
+        static uint64_t computeHash(const osg::Image* image, const ImageOptions& options);
+
+        // images with the same hash are only shared when their dimensions, format, settings and data all match
+        vsg::ref_ptr<vsg::Data> getOrCreateData(const osg::Image* image, const ImageOptions& options);
+        vsg::ref_ptr<vsg::DescriptorImage> getOrCreateDescriptorImage(const osg::Texture* texture, uint32_t binding, const ImageOptions& options);
+
+        // remove the textures no longer referenced outside the registry, least recently requested first, until
+        // those left take at most maxUnusedBytes. textures still in use are kept so they stay shared.
+        void releaseUnused(uint64_t maxUnusedBytes = 0);
+
+        // remove all the textures, those still in use are no longer shared with later requests
+        void clear();
+
+        struct Stats
+        {
+            size_t numImageRequests = 0;
+            size_t numUniqueImages = 0;
+            size_t numUniqueSamplers = 0;
+            size_t numUniqueDescriptorImages = 0;
+            uint64_t numBytes = 0; // image data, plus the source images kept for comparing contents
+        };
+
+        Stats getStats() const;
+
+        vsg::ref_ptr<SamplerCache> samplerCache = SamplerCache::create();
+
+    protected:
+        virtual ~TextureRegistry() {}
+
+        struct ImageEntry
+        {
+            // description of the source, taken before conversion as moving its data into the vsg::Data leaves it empty
+            int s = 0;
+            int t = 0;
+            int r = 0;
+            GLenum pixelFormat = 0;
+            GLenum dataType = 0;
+            unsigned int packing = 0;
+            int origin = 0;
+            size_t size = 0;
+            ImageOptions options;
+
+            // the source when its data was copied, otherwise data holds the source's bytes unchanged
+            osg::ref_ptr<const osg::Image> source;
+            vsg::ref_ptr<vsg::Data> data;
+            uint64_t lastRequest = 0;
+
+            const void* contents() const;
+            uint64_t numBytes() const;
+        };
+
+        static ImageEntry describe(const osg::Image* image, const ImageOptions& options);
+        static bool sameImage(const ImageEntry& lhs, const ImageEntry& rhs);
+
+        using DescriptorImageKey = std::tuple<const vsg::Data*, const vsg::Sampler*, uint32_t>;
+
+        mutable std::mutex _mutex;
+        std::multimap<uint64_t, ImageEntry> _images;
+        std::map<DescriptorImageKey, vsg::ref_ptr<vsg::DescriptorImage>> _descriptorImages;
+        size_t _numImageRequests = 0;
+    };
+}
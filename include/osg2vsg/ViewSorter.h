@@ -0,0 +1,54 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+
+#include <vsg/all.h>
+
+#include <array>
+#include <vector>
+
+namespace osg2vsg
+{
+    // reorders the children of groups for the current view, so plain vsg::Groups can act as depth sorted bins without
+    // the scene graph needing node types the viewer doesn't know about. call sort() each frame before recording commands.
+    class OSG2VSG_DECLSPEC ViewSorter : public vsg::Inherit<vsg::Object, ViewSorter>
+    {
+    public:
+        ViewSorter() {}
+
+        // sort the children of group back to front by the distance of their centres from the eye, for blended geometry.
+        // centres are in the coordinate frame of the scene graph root, one per child in the group's current order.
+        void addDepthSortedGroup(vsg::ref_ptr<vsg::Group> group, const std::vector<vsg::dvec3>& centres);
+
+        // order the children of group front to back along whichever axis is closest to the view direction, for early depth rejection.
+        // the orders are computed up front so the group is only reordered when that axis changes.
+        void addFrontToBackGroup(vsg::ref_ptr<vsg::Group> group, const std::vector<vsg::dvec3>& centres);
+
+        void sort(const vsg::dvec3& eye, const vsg::dvec3& viewDirection);
+
+        size_t getNumDepthSortedGroups() const { return _depthSortedGroups.size(); }
+        size_t getNumFrontToBackGroups() const { return _frontToBackGroups.size(); }
+
+    protected:
+        virtual ~ViewSorter() {}
+
+        struct DepthSortedGroup
+        {
+            vsg::ref_ptr<vsg::Group> group;
+            vsg::Group::Children children;
+            std::vector<vsg::dvec3> centres;
+            std::vector<uint32_t> order; // kept between frames so the insertion sort usually only has a few children to move
+            std::vector<double> distances;
+        };
+
+        struct FrontToBackGroup
+        {
+            vsg::ref_ptr<vsg::Group> group;
+            std::array<vsg::Group::Children, 6> axisChildren; // +x, -x, +y, -y, +z, -z
+            int axis = -1;
+        };
+
+        std::vector<DepthSortedGroup> _depthSortedGroups;
+        std::vector<FrontToBackGroup> _frontToBackGroups;
+    };
+}
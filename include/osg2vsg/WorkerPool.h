@@ -0,0 +1,40 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+
+#include <vsg/core/Inherit.h>
+#include <vsg/core/Object.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace osg2vsg
+{
+    // fixed size pool of threads that can be shared between SceneBuilders to run conversion tasks concurrently
+    class OSG2VSG_DECLSPEC WorkerPool : public vsg::Inherit<vsg::Object, WorkerPool>
+    {
+    public:
+        WorkerPool(uint32_t numThreads);
+        virtual ~WorkerPool();
+
+        uint32_t getNumThreads() const { return static_cast<uint32_t>(_threads.size()); }
+
+        // call func(i) for every i in the range [0, count) and return once all have completed.
+        // the calling thread takes part in the work so calls from several threads, or from within a task, can't deadlock the pool.
+        // if func throws, the remaining indices are skipped and the first exception is rethrown once no calls are running.
+        void run(size_t count, const std::function<void(size_t)>& func);
+
+    protected:
+        void add(std::function<void()> task);
+
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::deque<std::function<void()>> _tasks;
+        std::vector<std::thread> _threads;
+        bool _active = true;
+    };
+}
@@ -0,0 +1,101 @@
+#include <osg2vsg/ConversionObserver.h>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+
+using namespace osg2vsg;
+
+namespace
+{
+    void writeString(std::ostream& out, const std::string& str)
+    {
+        out<<'"';
+        for(auto c : str)
+        {
+            if (c=='"' || c=='\\') out<<'\\'<<c;
+            else if (static_cast<unsigned char>(c)<0x20) out<<' ';
+            else out<<c;
+        }
+        out<<'"';
+    }
+}
+
+ChromeTraceWriter::ChromeTraceWriter():
+    _startTime(clock::now())
+{
+}
+
+void ChromeTraceWriter::beginPhase(const std::string& phase)
+{
+    std::lock_guard<std::mutex> guard(_mutex);
+    _openPhases.emplace_back(phase, clock::now());
+}
+
+void ChromeTraceWriter::endPhase(const std::string& phase, const PhaseStats& stats, double milliseconds)
+{
+    std::lock_guard<std::mutex> guard(_mutex);
+
+    // phases nest, so the phase ending is the most recent one begun with its name
+    auto itr = _openPhases.rbegin();
+    for(; itr != _openPhases.rend() && itr->first!=phase; ++itr) {}
+    if (itr == _openPhases.rend())
+    {
+        std::cout<<"Warning: ChromeTraceWriter::endPhase("<<phase<<") called without a matching beginPhase(), phase not recorded."<<std::endl;
+        return;
+    }
+
+    Event event;
+    event.name = phase;
+    event.start = std::chrono::duration<double, std::chrono::microseconds::period>(itr->second - _startTime).count();
+    event.duration = milliseconds*1000.0;
+    event.stats = stats;
+    _events.push_back(event);
+
+    _openPhases.erase(std::next(itr).base());
+}
+
+size_t ChromeTraceWriter::getNumEvents() const
+{
+    std::lock_guard<std::mutex> guard(_mutex);
+    return _events.size();
+}
+
+bool ChromeTraceWriter::write(const std::string& filename) const
+{
+    std::ofstream fout(filename);
+    if (!fout)
+    {
+        std::cout<<"Warning: ChromeTraceWriter::write() could not open "<<filename<<std::endl;
+        return false;
+    }
+
+    write(fout);
+    return fout.good();
+}
+
+void ChromeTraceWriter::write(std::ostream& out) const
+{
+    std::lock_guard<std::mutex> guard(_mutex);
+
+    // the default precision would round timestamps of long conversions to tens of microseconds
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out<<std::fixed<<std::setprecision(3);
+
+    // complete ("X") events on one thread, the viewer nests any phases that lie within others
+    out<<"{\"traceEvents\":[";
+    for(size_t i=0; i<_events.size(); ++i)
+    {
+        auto& event = _events[i];
+        out<<(i>0 ? ",\n" : "\n")<<"{\"name\":";
+        writeString(out, event.name);
+        out<<",\"cat\":\"osg2vsg\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"<<event.start<<",\"dur\":"<<event.duration;
+        out<<",\"args\":{\"count\":"<<event.stats.count<<",\"bytes\":"<<event.stats.bytes<<"}}";
+    }
+    out<<"\n],\"displayTimeUnit\":\"ms\"}"<<std::endl;
+
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,113 @@
+#include <osg2vsg/CullHierarchy.h>
+
+#include <vsg/nodes/CullGroup.h>
+
+#include <algorithm>
+
+namespace osg2vsg
+{
+
+    vsg::sphere mergeSpheres(const vsg::sphere& lhs, const vsg::sphere& rhs)
+    {
+        vsg::vec3 delta = rhs.center - lhs.center;
+        float distance = vsg::length(delta);
+
+        // one sphere already encloses the other, this also covers coincident centres
+        if (distance + rhs.radius <= lhs.radius) return lhs;
+        if (distance + lhs.radius <= rhs.radius) return rhs;
+
+        float radius = (distance + lhs.radius + rhs.radius) * 0.5f;
+        return vsg::sphere(lhs.center + delta * ((radius - lhs.radius) / distance), radius);
+    }
+
+    vsg::sphere computeEnclosingSphere(CullItems::const_iterator begin, CullItems::const_iterator end)
+    {
+        if (begin == end) return vsg::sphere(0.0f, 0.0f, 0.0f, 0.0f);
+
+        vsg::sphere merged = begin->bound;
+        vsg::vec3 extentsMin = begin->bound.center - vsg::vec3(begin->bound.radius, begin->bound.radius, begin->bound.radius);
+        vsg::vec3 extentsMax = begin->bound.center + vsg::vec3(begin->bound.radius, begin->bound.radius, begin->bound.radius);
+        for (auto itr = begin + 1; itr != end; ++itr)
+        {
+            merged = mergeSpheres(merged, itr->bound);
+
+            for (int i = 0; i < 3; ++i)
+            {
+                extentsMin[i] = std::min(extentsMin[i], itr->bound.center[i] - itr->bound.radius);
+                extentsMax[i] = std::max(extentsMax[i], itr->bound.center[i] + itr->bound.radius);
+            }
+        }
+
+        // merging in turn depends on the order of the items, so also try the sphere centred on their bounding box
+        vsg::vec3 center = (extentsMin + extentsMax) * 0.5f;
+        float radius = 0.0f;
+        for (auto itr = begin; itr != end; ++itr)
+        {
+            radius = std::max(radius, vsg::length(itr->bound.center - center) + itr->bound.radius);
+        }
+
+        return (radius < merged.radius) ? vsg::sphere(center, radius) : merged;
+    }
+
+    namespace
+    {
+        using Range = std::pair<CullItems::iterator, CullItems::iterator>;
+
+        // split the range in two at the median of the longest axis of the item centres
+        std::pair<Range, Range> splitAtMedian(const Range& range)
+        {
+            vsg::vec3 centersMin = range.first->bound.center;
+            vsg::vec3 centersMax = range.first->bound.center;
+            for (auto itr = range.first; itr != range.second; ++itr)
+            {
+                for (int i = 0; i < 3; ++i)
+                {
+                    centersMin[i] = std::min(centersMin[i], itr->bound.center[i]);
+                    centersMax[i] = std::max(centersMax[i], itr->bound.center[i]);
+                }
+            }
+
+            vsg::vec3 extents = centersMax - centersMin;
+            int axis = (extents.x >= extents.y && extents.x >= extents.z) ? 0 : ((extents.y >= extents.z) ? 1 : 2);
+
+            auto middle = range.first + (range.second - range.first) / 2;
+            std::nth_element(range.first, middle, range.second, [axis](const CullItem& lhs, const CullItem& rhs) { return lhs.bound.center[axis] < rhs.bound.center[axis]; });
+
+            return {Range(range.first, middle), Range(middle, range.second)};
+        }
+
+        CullItem createHierarchy(const Range& range, uint32_t fanOut)
+        {
+            if (range.second - range.first == 1) return *range.first;
+
+            // keep splitting the largest part until there are fanOut parts, or every part holds a single item
+            std::vector<Range> parts{range};
+            while (parts.size() < fanOut)
+            {
+                auto largest = std::max_element(parts.begin(), parts.end(), [](const Range& lhs, const Range& rhs) { return (lhs.second - lhs.first) < (rhs.second - rhs.first); });
+                if (largest->second - largest->first <= 1) break;
+
+                auto [lower, upper] = splitAtMedian(*largest);
+                *largest = lower;
+                parts.insert(largest + 1, upper);
+            }
+
+            CullItems children;
+            for (auto& part : parts) children.push_back(createHierarchy(part, fanOut));
+
+            auto bound = computeEnclosingSphere(children.begin(), children.end());
+            auto cullGroup = vsg::CullGroup::create(bound);
+            for (auto& child : children) cullGroup->addChild(child.node);
+
+            return CullItem{bound, cullGroup};
+        }
+    }
+
+    vsg::ref_ptr<vsg::Node> createCullHierarchy(CullItems items, uint32_t fanOut)
+    {
+        if (items.empty()) return vsg::ref_ptr<vsg::Node>();
+
+        return createHierarchy(Range(items.begin(), items.end()), std::max(fanOut, 2u)).node;
+    }
+
+}
@@ -5,6 +5,8 @@
 #include <osgUtil/MeshOptimizers>
 #include <osgUtil/TangentSpaceGenerator>
 
+#include <cstring>
+
 namespace osg2vsg
 {
 
@@ -192,7 +194,7 @@ namespace osg2vsg
         }
     }
 
-    vsg::ref_ptr<vsg::Sampler> convertToSampler(const osg::Texture* texture)
+    vsg::ref_ptr<vsg::Sampler> convertToSampler(const osg::Texture* texture, uint32_t maxDimension)
     {
         auto minFilter = texture->getFilter(osg::Texture::MIN_FILTER);
         auto magFilter = texture->getFilter(osg::Texture::MAG_FILTER);
@@ -215,10 +217,24 @@ namespace osg2vsg
 
         if (mipmappingRequired)
         {
+            // textures without an image are converted to a 1x1 white texture
             const osg::Image* image = (texture->getNumImages()>0) ? texture->getImage(0) : nullptr;
+            int width = image ? std::max(image->s(), 1) : 1;
+            int height = image ? std::max(image->t(), 1) : 1;
+            int depth = image ? std::max(image->r(), 1) : 1;
 
-            auto maxDimension = std::max({image->s(), image->t(), image->r()});
-            auto numMipMapLevels = static_cast<uint32_t>(std::floor(std::log2(maxDimension)))+1;
+            // match the halving downscaleImage() applies to uncompressed 2D images
+            if (maxDimension>0 && image && !image->isCompressed() && depth==1)
+            {
+                while(static_cast<uint32_t>(std::max(width, height))>maxDimension)
+                {
+                    width = std::max(width/2, 1);
+                    height = std::max(height/2, 1);
+                }
+            }
+
+            auto maxImageDimension = std::max({width, height, depth});
+            auto numMipMapLevels = static_cast<uint32_t>(std::floor(std::log2(maxImageDimension)))+1;
 
             sampler->minLod = 0;
             sampler->maxLod = static_cast<float>(numMipMapLevels);
@@ -249,6 +265,35 @@ namespace osg2vsg
         return sampler;
     }
 
+    vsg::ref_ptr<vsg::Sampler> SamplerCache::getOrCreateSampler(const osg::Texture* texture, uint32_t maxDimension)
+    {
+        if (!texture) return {};
+
+        auto sampler = convertToSampler(texture, maxDimension);
+
+        auto asKey = [](float value) { uint32_t key; std::memcpy(&key, &value, sizeof(key)); return key; };
+
+        SamplerKey key{
+            static_cast<uint32_t>(sampler->minFilter), static_cast<uint32_t>(sampler->magFilter), static_cast<uint32_t>(sampler->mipmapMode),
+            static_cast<uint32_t>(sampler->addressModeU), static_cast<uint32_t>(sampler->addressModeV), static_cast<uint32_t>(sampler->addressModeW),
+            asKey(sampler->mipLodBias), static_cast<uint32_t>(sampler->anisotropyEnable), asKey(sampler->maxAnisotropy),
+            static_cast<uint32_t>(sampler->compareEnable), static_cast<uint32_t>(sampler->compareOp),
+            asKey(sampler->minLod), asKey(sampler->maxLod), static_cast<uint32_t>(sampler->borderColor),
+            static_cast<uint32_t>(sampler->unnormalizedCoordinates)
+        };
+
+        std::lock_guard<std::mutex> guard(_mutex);
+        auto& cached = _samplers[key];
+        if (!cached) cached = sampler;
+        return cached;
+    }
+
+    size_t SamplerCache::size() const
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        return _samplers.size();
+    }
+
     vsg::ref_ptr<vsg::materialValue> convertToMaterialValue(const osg::Material* material)
     {
         auto matvalue = vsg::materialValue::create();
@@ -431,5 +476,129 @@ namespace osg2vsg
         return geometry;
     }
 
+    namespace
+    {
+        template<class A>
+        osg::ref_ptr<A> transformPositions(const A* positions, const osg::Matrix& matrix)
+        {
+            osg::ref_ptr<A> transformed = new A(*positions, osg::CopyOp::DEEP_COPY_ALL);
+            for(auto& position : *transformed) position = position * matrix;
+            return transformed;
+        }
+    }
+
+    osg::ref_ptr<osg::Geometry> createTransformedGeometry(const osg::Geometry* geometry, const osg::Matrix& matrix)
+    {
+        auto vec3Vertices = dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+        auto vec3dVertices = dynamic_cast<const osg::Vec3dArray*>(geometry->getVertexArray());
+        if (!vec3Vertices && !vec3dVertices) return osg::ref_ptr<osg::Geometry>();
+
+        // the copy shares all but the arrays that are replaced, so the original arrays are left untouched
+        osg::ref_ptr<osg::Geometry> transformed = new osg::Geometry(*geometry, osg::CopyOp::SHALLOW_COPY);
+
+        if (vec3Vertices) transformed->setVertexArray(transformPositions(vec3Vertices, matrix));
+        else transformed->setVertexArray(transformPositions(vec3dVertices, matrix));
+
+        // normals transform by the inverse transpose, which for OSG's row vectors is transform3x3(inverse, normal)
+        if (auto normals = dynamic_cast<const osg::Vec3Array*>(geometry->getNormalArray()))
+        {
+            osg::Matrix inverse = osg::Matrix::inverse(matrix);
+            osg::ref_ptr<osg::Vec3Array> transformedNormals = new osg::Vec3Array(*normals, osg::CopyOp::DEEP_COPY_ALL);
+            for(auto& normal : *transformedNormals)
+            {
+                normal = osg::Matrix::transform3x3(inverse, normal);
+                normal.normalize();
+            }
+            transformed->setNormalArray(transformedNormals, normals->getBinding());
+        }
+
+        // tangents follow the surface so transform like directions, keeping the handedness in w
+        if (auto tangents = dynamic_cast<const osg::Vec4Array*>(geometry->getVertexAttribArray(6)))
+        {
+            osg::ref_ptr<osg::Vec4Array> transformedTangents = new osg::Vec4Array(*tangents, osg::CopyOp::DEEP_COPY_ALL);
+            for(auto& tangent : *transformedTangents)
+            {
+                osg::Vec3 direction = osg::Matrix::transform3x3(osg::Vec3(tangent.x(), tangent.y(), tangent.z()), matrix);
+                direction.normalize();
+                tangent.set(direction.x(), direction.y(), direction.z(), tangent.w());
+            }
+            transformed->setVertexAttribArray(6, transformedTangents, tangents->getBinding());
+        }
+
+        return transformed;
+    }
+
+    vsg::sphere computeBoxBoundingSphere(const osg::Geometry* geometry)
+    {
+        const osg::BoundingBox& bb = geometry->getBoundingBox();
+        vsg::vec3 bb_min(bb.xMin(), bb.yMin(), bb.zMin());
+        vsg::vec3 bb_max(bb.xMax(), bb.yMax(), bb.zMax());
+        return vsg::sphere((bb_min + bb_max)*0.5f, vsg::length(bb_max - bb_min)*0.5f);
+    }
+
+    namespace
+    {
+        // Ritter's bounding sphere, starting from the most separated pair of the extreme points along each axis
+        // then growing the sphere to take in any vertex outside it
+        template<class A>
+        bool computeRitterSphere(const A* vertices, osg::Vec3d& center, double& radius)
+        {
+            if (!vertices || vertices->empty()) return false;
+
+            osg::Vec3d minPoints[3], maxPoints[3];
+            for(int i=0; i<3; ++i) minPoints[i] = maxPoints[i] = osg::Vec3d((*vertices)[0]);
+
+            for(auto& vertex : *vertices)
+            {
+                osg::Vec3d v(vertex);
+                for(int i=0; i<3; ++i)
+                {
+                    if (v[i] < minPoints[i][i]) minPoints[i] = v;
+                    if (v[i] > maxPoints[i][i]) maxPoints[i] = v;
+                }
+            }
+
+            int axis = 0;
+            for(int i=1; i<3; ++i)
+            {
+                if ((maxPoints[i]-minPoints[i]).length2() > (maxPoints[axis]-minPoints[axis]).length2()) axis = i;
+            }
+
+            center = (minPoints[axis] + maxPoints[axis])*0.5;
+            radius = (maxPoints[axis] - minPoints[axis]).length()*0.5;
+
+            for(auto& vertex : *vertices)
+            {
+                osg::Vec3d v(vertex);
+                double distance = (v - center).length();
+                if (distance > radius)
+                {
+                    // move the centre towards the vertex just far enough for the grown sphere to still enclose the old one
+                    double newRadius = (radius + distance)*0.5;
+                    center += (v - center)*((newRadius - radius)/distance);
+                    radius = newRadius;
+                }
+            }
+
+            return true;
+        }
+    }
+
+    vsg::sphere computeBoundingSphere(const osg::Geometry* geometry)
+    {
+        vsg::sphere boxSphere = computeBoxBoundingSphere(geometry);
+        if (geometry->getComputeBoundingBoxCallback()) return boxSphere;
+
+        osg::Vec3d center;
+        double radius = 0.0;
+        bool computed = computeRitterSphere(dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray()), center, radius) ||
+                        computeRitterSphere(dynamic_cast<const osg::Vec3dArray*>(geometry->getVertexArray()), center, radius);
+
+        if (!computed || radius >= boxSphere.radius) return boxSphere;
+
+        // pad the radius a little so rounding to float can't leave vertices just outside
+        return vsg::sphere(vsg::vec3(center.x(), center.y(), center.z()), static_cast<float>(radius*1.000001));
+    }
+
 }
 
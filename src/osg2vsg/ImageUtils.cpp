@@ -17,6 +17,14 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include <vsg/core/Array2D.h>
 #include <vsg/core/Array3D.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
+
 namespace osg2vsg
 {
 
@@ -49,7 +57,20 @@ osg::ref_ptr<osg::Image> formatImage(const osg::Image* image, GLenum targetPixel
 {
     if (targetPixelFormat==image->getPixelFormat())
     {
-        return const_cast<osg::Image*>(image);
+        // vsg::Data has no row padding, so only images whose rows are tightly packed can be used as they are
+        size_t rowSize = static_cast<size_t>(image->s())*osg::Image::computePixelSizeInBits(targetPixelFormat, image->getDataType())/8;
+        if (image->getRowStepInBytes()==rowSize) return const_cast<osg::Image*>(image);
+
+        osg::ref_ptr<osg::Image> new_image(new osg::Image);
+        new_image->allocateImage(image->s(), image->t(), image->r(), targetPixelFormat, image->getDataType());
+        for(int r=0; r<image->r(); ++r)
+        {
+            for(int t=0; t<image->t(); ++t)
+            {
+                std::memcpy(new_image->data(0, t, r), image->data(0, t, r), rowSize);
+            }
+        }
+        return new_image;
     }
 
     osg::ref_ptr<osg::Image> new_image( new osg::Image);
@@ -84,6 +105,10 @@ osg::ref_ptr<osg::Image> formatImage(const osg::Image* image, GLenum targetPixel
             numBytesPerComponent = 4;
             *reinterpret_cast<unsigned int*>(component_default) = 4294967295;
             break;
+        case(GL_HALF_FLOAT) :
+            numBytesPerComponent = 2;
+            *reinterpret_cast<uint16_t*>(component_default) = 0x3c00; // 1.0
+            break;
         case(GL_FLOAT) :
             numBytesPerComponent = 4;
             *reinterpret_cast<float*>(component_default) = 1.0f;
@@ -178,6 +203,29 @@ osg::ref_ptr<osg::Image> formatImage(const osg::Image* image, GLenum targetPixel
 }
 
 
+// return the image's data, including mipmaps, as a new[] allocated buffer for a vsg::Data to take ownership of.
+// when moving is allowed and the data was allocated with new[], the buffer is detached from the image without a copy,
+// leaving the image empty, otherwise a copy is returned so the image is left untouched.
+uint8_t* releaseImageData(osg::Image* image, bool allowMove)
+{
+    if (allowMove && image->getAllocationMode()==osg::Image::USE_NEW_DELETE)
+    {
+        // keep the modified count, so statistics cached against the image's contents before the move still match it
+        auto modifiedCount = image->getModifiedCount();
+
+        uint8_t* data = image->data();
+        image->setAllocationMode(osg::Image::NO_DELETE);
+        image->setImage(0, 0, 0, image->getInternalTextureFormat(), image->getPixelFormat(), image->getDataType(), nullptr, osg::Image::NO_DELETE);
+        image->setModifiedCount(modifiedCount);
+        return data;
+    }
+
+    auto size = image->getTotalSizeInBytesIncludingMipmaps();
+    uint8_t* data = new uint8_t[size];
+    std::memcpy(data, image->data(), size);
+    return data;
+}
+
 vsg::ref_ptr<vsg::Data> createWhiteTexture()
 {
     vsg::ref_ptr<vsg::vec4Array2D> vsg_data(new vsg::vec4Array2D(1,1));
@@ -189,10 +237,18 @@ vsg::ref_ptr<vsg::Data> createWhiteTexture()
     return vsg_data;
 }
 
-vsg::ref_ptr<vsg::Data> convertCompressedImageToVsg(const osg::Image* image)
+vsg::ref_ptr<vsg::Data> convertCompressedImageToVsg(osg::Image* image, bool allowMove)
 {
     uint32_t blockSize = 0;
     vsg::Data::Layout layout;
+    auto setBlock = [&](uint32_t size, uint8_t width, uint8_t height, VkFormat format)
+    {
+        blockSize = size;
+        layout.blockWidth = width;
+        layout.blockHeight = height;
+        layout.format = format;
+    };
+
     switch(image->getPixelFormat())
     {
         case(GL_COMPRESSED_ALPHA_ARB):
@@ -202,78 +258,61 @@ vsg::ref_ptr<vsg::Data> convertCompressedImageToVsg(const osg::Image* image)
         case(GL_COMPRESSED_RGBA_ARB):
         case(GL_COMPRESSED_RGB_ARB):
             break;
-        case(GL_COMPRESSED_RGB_S3TC_DXT1_EXT):
-            blockSize = 64;
-            layout.blockWidth = 4;
-            layout.blockHeight = 4;
-            layout.format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
-            break;
-        case(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT):
-            blockSize = 64;
-            layout.blockWidth = 4;
-            layout.blockHeight = 4;
-            layout.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
-            break;
-        case(GL_COMPRESSED_RGBA_S3TC_DXT3_EXT):
-            blockSize = 128;
-            layout.blockWidth = 4;
-            layout.blockHeight = 4;
-            layout.format = VK_FORMAT_BC2_UNORM_BLOCK;
-            break;
-        case(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT):
-            blockSize = 128;
-            layout.blockWidth = 4;
-            layout.blockHeight = 4;
-            layout.format = VK_FORMAT_BC3_UNORM_BLOCK;
-            break;
-        case(GL_COMPRESSED_SIGNED_RED_RGTC1_EXT):
-        case(GL_COMPRESSED_RED_RGTC1_EXT):
-        case(GL_COMPRESSED_SIGNED_RED_GREEN_RGTC2_EXT):
-        case(GL_COMPRESSED_RED_GREEN_RGTC2_EXT):
+        case(GL_COMPRESSED_RGB_S3TC_DXT1_EXT): setBlock(64, 4, 4, VK_FORMAT_BC1_RGB_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT): setBlock(64, 4, 4, VK_FORMAT_BC1_RGBA_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_S3TC_DXT3_EXT): setBlock(128, 4, 4, VK_FORMAT_BC2_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT): setBlock(128, 4, 4, VK_FORMAT_BC3_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_SIGNED_RED_RGTC1_EXT): setBlock(64, 4, 4, VK_FORMAT_BC4_SNORM_BLOCK); break;
+        case(GL_COMPRESSED_RED_RGTC1_EXT): setBlock(64, 4, 4, VK_FORMAT_BC4_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_SIGNED_RED_GREEN_RGTC2_EXT): setBlock(128, 4, 4, VK_FORMAT_BC5_SNORM_BLOCK); break;
+        case(GL_COMPRESSED_RED_GREEN_RGTC2_EXT): setBlock(128, 4, 4, VK_FORMAT_BC5_UNORM_BLOCK); break;
         case(GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG):
         case(GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG):
         case(GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG):
         case(GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG):
-        case(GL_ETC1_RGB8_OES):
-        case(GL_COMPRESSED_RGB8_ETC2):
-        case(GL_COMPRESSED_SRGB8_ETC2):
-        case(GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2):
-        case(GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2):
-        case(GL_COMPRESSED_RGBA8_ETC2_EAC):
-        case(GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC):
-        case(GL_COMPRESSED_R11_EAC):
-        case(GL_COMPRESSED_SIGNED_R11_EAC):
-        case(GL_COMPRESSED_RG11_EAC):
-        case(GL_COMPRESSED_SIGNED_RG11_EAC):
-        case (GL_COMPRESSED_RGBA_ASTC_4x4_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_5x4_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_5x5_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_6x5_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_6x6_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_8x5_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_8x6_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_8x8_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_10x5_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_10x6_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_10x8_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_10x10_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_12x10_KHR) :
-        case (GL_COMPRESSED_RGBA_ASTC_12x12_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_5x4_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_5x5_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x5_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x5_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x6_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x5_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x6_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x8_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x10_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x10_KHR) :
-        case (GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR) :
+            // PVRTC requires the VK_IMG_format_pvrtc extension so isn't supported
             break;
+        // ETC2 is a superset of ETC1 so ETC1 data can be passed through unchanged
+        case(GL_ETC1_RGB8_OES): setBlock(64, 4, 4, VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGB8_ETC2): setBlock(64, 4, 4, VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ETC2): setBlock(64, 4, 4, VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2): setBlock(64, 4, 4, VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2): setBlock(64, 4, 4, VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_RGBA8_ETC2_EAC): setBlock(128, 4, 4, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC): setBlock(128, 4, 4, VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_R11_EAC): setBlock(64, 4, 4, VK_FORMAT_EAC_R11_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_SIGNED_R11_EAC): setBlock(64, 4, 4, VK_FORMAT_EAC_R11_SNORM_BLOCK); break;
+        case(GL_COMPRESSED_RG11_EAC): setBlock(128, 4, 4, VK_FORMAT_EAC_R11G11_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_SIGNED_RG11_EAC): setBlock(128, 4, 4, VK_FORMAT_EAC_R11G11_SNORM_BLOCK); break;
+        // all ASTC block sizes are encoded in 128 bits
+        case(GL_COMPRESSED_RGBA_ASTC_4x4_KHR): setBlock(128, 4, 4, VK_FORMAT_ASTC_4x4_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_5x4_KHR): setBlock(128, 5, 4, VK_FORMAT_ASTC_5x4_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_5x5_KHR): setBlock(128, 5, 5, VK_FORMAT_ASTC_5x5_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_6x5_KHR): setBlock(128, 6, 5, VK_FORMAT_ASTC_6x5_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_6x6_KHR): setBlock(128, 6, 6, VK_FORMAT_ASTC_6x6_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_8x5_KHR): setBlock(128, 8, 5, VK_FORMAT_ASTC_8x5_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_8x6_KHR): setBlock(128, 8, 6, VK_FORMAT_ASTC_8x6_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_8x8_KHR): setBlock(128, 8, 8, VK_FORMAT_ASTC_8x8_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_10x5_KHR): setBlock(128, 10, 5, VK_FORMAT_ASTC_10x5_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_10x6_KHR): setBlock(128, 10, 6, VK_FORMAT_ASTC_10x6_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_10x8_KHR): setBlock(128, 10, 8, VK_FORMAT_ASTC_10x8_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_10x10_KHR): setBlock(128, 10, 10, VK_FORMAT_ASTC_10x10_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_12x10_KHR): setBlock(128, 12, 10, VK_FORMAT_ASTC_12x10_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_RGBA_ASTC_12x12_KHR): setBlock(128, 12, 12, VK_FORMAT_ASTC_12x12_UNORM_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR): setBlock(128, 4, 4, VK_FORMAT_ASTC_4x4_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_5x4_KHR): setBlock(128, 5, 4, VK_FORMAT_ASTC_5x4_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_5x5_KHR): setBlock(128, 5, 5, VK_FORMAT_ASTC_5x5_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x5_KHR): setBlock(128, 6, 5, VK_FORMAT_ASTC_6x5_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR): setBlock(128, 6, 6, VK_FORMAT_ASTC_6x6_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x5_KHR): setBlock(128, 8, 5, VK_FORMAT_ASTC_8x5_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x6_KHR): setBlock(128, 8, 6, VK_FORMAT_ASTC_8x6_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR): setBlock(128, 8, 8, VK_FORMAT_ASTC_8x8_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x5_KHR): setBlock(128, 10, 5, VK_FORMAT_ASTC_10x5_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x6_KHR): setBlock(128, 10, 6, VK_FORMAT_ASTC_10x6_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x8_KHR): setBlock(128, 10, 8, VK_FORMAT_ASTC_10x8_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_10x10_KHR): setBlock(128, 10, 10, VK_FORMAT_ASTC_10x10_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x10_KHR): setBlock(128, 12, 10, VK_FORMAT_ASTC_12x10_SRGB_BLOCK); break;
+        case(GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR): setBlock(128, 12, 12, VK_FORMAT_ASTC_12x12_SRGB_BLOCK); break;
         default:
             break;
     }
@@ -284,21 +323,21 @@ vsg::ref_ptr<vsg::Data> convertCompressedImageToVsg(const osg::Image* image)
         return createWhiteTexture();
     }
 
-    // stop the OSG image from deleting the image data as we are passing this on to the vsg Data object
-    auto size = image->getTotalSizeInBytesIncludingMipmaps();
-    uint8_t* data = new uint8_t[size];
-    memcpy(data, image->data(), size);
-
     layout.maxNumMipmaps = image->getNumMipmapLevels();
+    layout.origin = (image->getOrigin()==osg::Image::BOTTOM_LEFT) ? vsg::BOTTOM_LEFT : vsg::TOP_LEFT;
 
-    uint32_t width = image->s() / layout.blockWidth;
-    uint32_t height = image->t() / layout.blockHeight;
-    uint32_t depth = image->r() / layout.blockDepth;
+    // partial blocks at the edges are still stored so round up
+    uint32_t width = (image->s() + layout.blockWidth - 1) / layout.blockWidth;
+    uint32_t height = (image->t() + layout.blockHeight - 1) / layout.blockHeight;
+    uint32_t depth = (image->r() + layout.blockDepth - 1) / layout.blockDepth;
+
+    // releasing the data may leave the image empty, so all its properties have to be read beforehand
+    uint8_t* data = releaseImageData(image, allowMove);
 
     vsg::ref_ptr<vsg::Data> vsg_data;
     if (blockSize==64)
     {
-        if (image->r()==1)
+        if (depth==1)
         {
             vsg_data = new vsg::block64Array2D(width, height, reinterpret_cast<vsg::block64*>(data));
         }
@@ -309,7 +348,7 @@ vsg::ref_ptr<vsg::Data> convertCompressedImageToVsg(const osg::Image* image)
     }
     else
     {
-        if (image->r()==1)
+        if (depth==1)
         {
             vsg_data = new vsg::block128Array2D(width, height, reinterpret_cast<vsg::block128*>(data));
         }
@@ -319,41 +358,1106 @@ vsg::ref_ptr<vsg::Data> convertCompressedImageToVsg(const osg::Image* image)
         }
     }
 
+    vsg_data->setLayout(layout);
+
+    return vsg_data;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+//
+//   Mipmap generation
+//
+namespace
+{
+
+// weights of the source samples that contribute to a single destination sample
+struct Contribution
+{
+    std::vector<int> indices;
+    std::vector<float> weights;
+};
+using Contributions = std::vector<Contribution>;
+
+double besselI0(double x)
+{
+    // power series, converges quickly for the small arguments used by the Kaiser window
+    double sum = 1.0;
+    double term = 1.0;
+    double halfX = x*0.5;
+    for(int k=1; k<32; ++k)
+    {
+        term *= (halfX/k)*(halfX/k);
+        sum += term;
+        if (term < sum*1e-12) break;
+    }
+    return sum;
+}
+
+double sinc(double x)
+{
+    if (std::abs(x)<1e-6) return 1.0;
+    double px = osg::PI*x;
+    return std::sin(px)/px;
+}
+
+Contributions computeContributions(int srcSize, int dstSize, MipmapFilter filter)
+{
+    Contributions contributions(dstSize);
+
+    // source sample i spans [i, i+1), destination sample x is centred on (x+0.5)*scale in source coordinates
+    double scale = static_cast<double>(srcSize)/static_cast<double>(dstSize);
+    for(int x=0; x<dstSize; ++x)
+    {
+        auto& contribution = contributions[x];
+        double center = (static_cast<double>(x)+0.5)*scale;
+
+        auto add = [&](int i, double weight)
+        {
+            contribution.indices.push_back(std::clamp(i, 0, srcSize-1));
+            contribution.weights.push_back(static_cast<float>(weight));
+        };
+
+        if (filter==MIPMAP_FILTER_KAISER)
+        {
+            // Kaiser windowed sinc, radius and alpha chosen to balance sharpness against ringing
+            const double radius = 3.0;
+            const double alpha = 4.0;
+            const double filterScale = std::max(scale, 1.0);
+            const double norm = 1.0/besselI0(alpha);
+
+            int first = static_cast<int>(std::floor(center - radius*filterScale));
+            int last = static_cast<int>(std::ceil(center + radius*filterScale));
+            for(int i=first; i<=last; ++i)
+            {
+                double t = ((static_cast<double>(i)+0.5) - center)/filterScale;
+                if (std::abs(t)>=radius) continue;
+
+                double r = t/radius;
+                add(i, sinc(t) * besselI0(alpha*std::sqrt(1.0-r*r)) * norm);
+            }
+        }
+        else
+        {
+            // box filter, weight each source sample by how much of the destination footprint it covers
+            double start = center - scale*0.5;
+            double end = center + scale*0.5;
+            int first = static_cast<int>(std::floor(start));
+            int last = static_cast<int>(std::ceil(end))-1;
+            for(int i=first; i<=last; ++i)
+            {
+                double overlap = std::min(end, static_cast<double>(i+1)) - std::max(start, static_cast<double>(i));
+                if (overlap>0.0) add(i, overlap);
+            }
+        }
+
+        float total = 0.0f;
+        for(auto weight : contribution.weights) total += weight;
+        if (total!=0.0f)
+        {
+            for(auto& weight : contribution.weights) weight /= total;
+        }
+    }
+
+    return contributions;
+}
+
+// resample a tightly packed float image, the rows are filtered first then the columns, with the inner loops kept
+// over contiguous components so the compiler is able to vectorize them.
+void resample(const std::vector<float>& src, int width, int height, int numComponents, std::vector<float>& dst, int newWidth, int newHeight, MipmapFilter filter)
+{
+    auto horizontal = computeContributions(width, newWidth, filter);
+    auto vertical = computeContributions(height, newHeight, filter);
+
+    std::vector<float> temp(static_cast<size_t>(newWidth)*height*numComponents, 0.0f);
+    for(int y=0; y<height; ++y)
+    {
+        const float* src_row = src.data() + static_cast<size_t>(y)*width*numComponents;
+        float* temp_row = temp.data() + static_cast<size_t>(y)*newWidth*numComponents;
+        for(int x=0; x<newWidth; ++x)
+        {
+            auto& contribution = horizontal[x];
+            float* d = temp_row + x*numComponents;
+            for(size_t k=0; k<contribution.indices.size(); ++k)
+            {
+                const float* s = src_row + contribution.indices[k]*numComponents;
+                float weight = contribution.weights[k];
+                for(int c=0; c<numComponents; ++c) d[c] += s[c]*weight;
+            }
+        }
+    }
+
+    size_t rowSize = static_cast<size_t>(newWidth)*numComponents;
+    dst.assign(rowSize*newHeight, 0.0f);
+    for(int y=0; y<newHeight; ++y)
+    {
+        auto& contribution = vertical[y];
+        float* dst_row = dst.data() + y*rowSize;
+        for(size_t k=0; k<contribution.indices.size(); ++k)
+        {
+            const float* temp_row = temp.data() + contribution.indices[k]*rowSize;
+            float weight = contribution.weights[k];
+            for(size_t i=0; i<rowSize; ++i) dst_row[i] += temp_row[i]*weight;
+        }
+    }
+}
+
+float sRGBToLinear(float c)
+{
+    return (c<=0.04045f) ? c/12.92f : std::pow((c+0.055f)/1.055f, 2.4f);
+}
+
+float linearToSRGB(float c)
+{
+    return (c<=0.0031308f) ? c*12.92f : 1.055f*std::pow(c, 1.0f/2.4f)-0.055f;
+}
+
+// which components hold colour, as opposed to alpha, and so need converting to linear space when the image is sRGB
+std::vector<bool> colorComponents(GLenum pixelFormat)
+{
+    switch(pixelFormat)
+    {
+        case(GL_ALPHA): return {false};
+        case(GL_LUMINANCE_ALPHA): return {true, false};
+        case(GL_RGB):
+        case(GL_BGR): return {true, true, true};
+        case(GL_RGBA):
+        case(GL_BGRA): return {true, true, true, false};
+        default: return std::vector<bool>(osg::Image::computeNumComponents(pixelFormat), true);
+    }
+}
+
+// read a 2D image into a tightly packed float array, converting sRGB colour components to linear
+std::vector<float> readImage(const osg::Image* image, const std::vector<bool>& linearize)
+{
+    int numComponents = static_cast<int>(linearize.size());
+    std::vector<float> values(static_cast<size_t>(image->s())*image->t()*numComponents);
+
+    float sRGBTable[256];
+    for(int i=0; i<256; ++i) sRGBTable[i] = sRGBToLinear(static_cast<float>(i)/255.0f);
+
+    float* dst = values.data();
+    for(int t=0; t<image->t(); ++t)
+    {
+        const unsigned char* row = image->data(0, t, 0);
+        for(int s=0; s<image->s(); ++s)
+        {
+            for(int c=0; c<numComponents; ++c, ++dst)
+            {
+                int i = s*numComponents+c;
+                switch(image->getDataType())
+                {
+                    case(GL_UNSIGNED_BYTE):
+                        *dst = linearize[c] ? sRGBTable[row[i]] : static_cast<float>(row[i])/255.0f;
+                        break;
+                    case(GL_UNSIGNED_SHORT):
+                    {
+                        float v = static_cast<float>(reinterpret_cast<const uint16_t*>(row)[i])/65535.0f;
+                        *dst = linearize[c] ? sRGBToLinear(v) : v;
+                        break;
+                    }
+                    default:
+                        *dst = reinterpret_cast<const float*>(row)[i];
+                        break;
+                }
+            }
+        }
+    }
+    return values;
+}
+
+// write a tightly packed float array to the destination, converting linear colour components back to sRGB
+void writeImage(const std::vector<float>& values, GLenum dataType, const std::vector<bool>& delinearize, unsigned char* dst)
+{
+    size_t numComponents = delinearize.size();
+    for(size_t i=0; i<values.size(); ++i)
+    {
+        float v = values[i];
+        if (dataType==GL_FLOAT)
+        {
+            reinterpret_cast<float*>(dst)[i] = v;
+            continue;
+        }
+
+        v = std::clamp(v, 0.0f, 1.0f);
+        if (delinearize[i % numComponents]) v = linearToSRGB(v);
+
+        if (dataType==GL_UNSIGNED_BYTE) dst[i] = static_cast<uint8_t>(v*255.0f+0.5f);
+        else reinterpret_cast<uint16_t*>(dst)[i] = static_cast<uint16_t>(v*65535.0f+0.5f);
+    }
+}
+
+} // end of anonymous namespace
+
+osg::ref_ptr<osg::Image> generateMipmaps(const osg::Image* image, MipmapFilter filter, bool sRGB)
+{
+    if (!image || filter==MIPMAP_FILTER_NONE || image->isCompressed() || image->isMipmap() || image->r()!=1 || !image->data())
+    {
+        return const_cast<osg::Image*>(image);
+    }
+
+    int bytesPerComponent = 0;
+    switch(image->getDataType())
+    {
+        case(GL_UNSIGNED_BYTE) : bytesPerComponent = 1; break;
+        case(GL_UNSIGNED_SHORT) : bytesPerComponent = 2; break;
+        case(GL_FLOAT) : bytesPerComponent = 4; break;
+        default:
+            std::cout<<"Warning: generateMipmaps() DataType "<<image->getDataType()<<" not supported."<<std::endl;
+            return const_cast<osg::Image*>(image);
+    }
+
+    // float images hold linear values so never need converting
+    auto linearize = colorComponents(image->getPixelFormat());
+    if (!sRGB || image->getDataType()==GL_FLOAT) linearize.assign(linearize.size(), false);
+
+    int numComponents = static_cast<int>(linearize.size());
+    int width = image->s();
+    int height = image->t();
+    int numLevels = osg::Image::computeNumberOfMipmapLevels(width, height, 1);
+
+    osg::Image::MipmapDataType mipmapOffsets;
+    size_t totalSize = 0;
+    for(int level=0; level<numLevels; ++level)
+    {
+        if (level>0) mipmapOffsets.push_back(static_cast<unsigned int>(totalSize));
+        totalSize += static_cast<size_t>(std::max(width>>level, 1)) * std::max(height>>level, 1) * numComponents * bytesPerComponent;
+    }
+
+    unsigned char* data = new unsigned char[totalSize];
+
+    // copy the base level across unchanged
+    size_t rowSize = static_cast<size_t>(width)*numComponents*bytesPerComponent;
+    for(int t=0; t<height; ++t)
+    {
+        std::memcpy(data + t*rowSize, image->data(0, t, 0), rowSize);
+    }
+
+    // filter each level from the previous one, staying in linear float space to avoid accumulating quantization errors
+    std::vector<float> level_values = readImage(image, linearize);
+    std::vector<float> next_values;
+    int levelWidth = width;
+    int levelHeight = height;
+    for(int level=1; level<numLevels; ++level)
+    {
+        int nextWidth = std::max(levelWidth/2, 1);
+        int nextHeight = std::max(levelHeight/2, 1);
+
+        resample(level_values, levelWidth, levelHeight, numComponents, next_values, nextWidth, nextHeight, filter);
+        writeImage(next_values, image->getDataType(), linearize, data + mipmapOffsets[level-1]);
+
+        level_values.swap(next_values);
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+
+    osg::ref_ptr<osg::Image> mipmapped = new osg::Image;
+    mipmapped->setImage(width, height, 1, image->getInternalTextureFormat(), image->getPixelFormat(), image->getDataType(), data, osg::Image::USE_NEW_DELETE, 1);
+    mipmapped->setMipmapLevels(mipmapOffsets);
+    mipmapped->setOrigin(image->getOrigin());
+
+    return mipmapped;
+}
+
+osg::ref_ptr<osg::Image> downscaleImage(const osg::Image* image, uint32_t maxDimension, MipmapFilter filter, bool sRGB)
+{
+    if (!image || maxDimension==0 || image->isCompressed() || image->r()!=1 || !image->data() ||
+        static_cast<uint32_t>(std::max(image->s(), image->t()))<=maxDimension)
+    {
+        return const_cast<osg::Image*>(image);
+    }
+
+    int bytesPerComponent = 0;
+    switch(image->getDataType())
+    {
+        case(GL_UNSIGNED_BYTE) : bytesPerComponent = 1; break;
+        case(GL_UNSIGNED_SHORT) : bytesPerComponent = 2; break;
+        case(GL_FLOAT) : bytesPerComponent = 4; break;
+        default:
+            std::cout<<"Warning: downscaleImage() DataType "<<image->getDataType()<<" not supported."<<std::endl;
+            return const_cast<osg::Image*>(image);
+    }
+
+    // halve the dimensions so that power of two images stay power of two
+    int width = image->s();
+    int height = image->t();
+    while(static_cast<uint32_t>(std::max(width, height))>maxDimension)
+    {
+        width = std::max(width/2, 1);
+        height = std::max(height/2, 1);
+    }
+
+    auto linearize = colorComponents(image->getPixelFormat());
+    if (!sRGB || image->getDataType()==GL_FLOAT) linearize.assign(linearize.size(), false);
+    int numComponents = static_cast<int>(linearize.size());
+
+    std::vector<float> downscaled;
+    resample(readImage(image, linearize), image->s(), image->t(), numComponents, downscaled, width, height, (filter==MIPMAP_FILTER_NONE) ? MIPMAP_FILTER_BOX : filter);
+
+    unsigned char* data = new unsigned char[static_cast<size_t>(width)*height*numComponents*bytesPerComponent];
+    writeImage(downscaled, image->getDataType(), linearize, data);
+
+    osg::ref_ptr<osg::Image> new_image = new osg::Image;
+    new_image->setImage(width, height, 1, image->getInternalTextureFormat(), image->getPixelFormat(), image->getDataType(), data, osg::Image::USE_NEW_DELETE, 1);
+    new_image->setOrigin(image->getOrigin());
+
+    return new_image;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+//
+//   Half float conversion
+//
+namespace
+{
+
+// convert a 32 bit float to a 16 bit float, rounding to nearest even and preserving infinities, NaNs and denormals
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    // infinity and NaN, keeping NaNs quiet
+    if (exponent==0xff) return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+    int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+
+    // too large so overflow to infinity
+    if (halfExponent>=0x1f) return static_cast<uint16_t>(sign | 0x7c00);
+
+    if (halfExponent<=0)
+    {
+        // too small even for a denormal so flush to zero
+        if (halfExponent < -10) return static_cast<uint16_t>(sign);
+
+        // denormal, shift in the implicit leading one
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t halfMantissa = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder>halfway || (remainder==halfway && (halfMantissa & 1))) ++halfMantissa;
+        return static_cast<uint16_t>(sign | halfMantissa);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+
+    // rounding may carry into the exponent, which correctly rounds up to the next power of two or infinity
+    if (remainder>0x1000 || (remainder==0x1000 && (half & 1))) ++half;
+    return static_cast<uint16_t>(half);
+}
+
+} // end of anonymous namespace
+
+osg::ref_ptr<osg::Image> convertToHalfFloat(const osg::Image* image)
+{
+    if (!image || image->getDataType()!=GL_FLOAT || image->isCompressed() || !image->data())
+    {
+        return const_cast<osg::Image*>(image);
+    }
+
+    int numComponents = static_cast<int>(osg::Image::computeNumComponents(image->getPixelFormat()));
+    int numLevels = static_cast<int>(image->getNumMipmapLevels());
+
+    // levels are tightly packed, as the mipmaps of the source image are
+    osg::Image::MipmapDataType mipmapOffsets;
+    size_t totalSize = 0;
+    for(int level=0; level<numLevels; ++level)
+    {
+        if (level>0) mipmapOffsets.push_back(static_cast<unsigned int>(totalSize*sizeof(uint16_t)));
+        totalSize += static_cast<size_t>(std::max(image->s()>>level, 1)) * std::max(image->t()>>level, 1) * std::max(image->r()>>level, 1) * numComponents;
+    }
+
+    uint16_t* data = new uint16_t[totalSize];
+    uint16_t* dst = data;
+    for(int level=0; level<numLevels; ++level)
+    {
+        int width = std::max(image->s()>>level, 1);
+        int numRows = std::max(image->t()>>level, 1) * std::max(image->r()>>level, 1);
+        size_t rowLength = static_cast<size_t>(width)*numComponents;
+        size_t rowSize = (level==0) ? image->getRowStepInBytes() : rowLength*sizeof(float);
+
+        const unsigned char* levelData = image->getMipmapData(level);
+        for(int row=0; row<numRows; ++row)
+        {
+            auto src = reinterpret_cast<const float*>(levelData + row*rowSize);
+            for(size_t i=0; i<rowLength; ++i) *(dst++) = floatToHalf(src[i]);
+        }
+    }
+
+    osg::ref_ptr<osg::Image> new_image = new osg::Image;
+    new_image->setImage(image->s(), image->t(), image->r(), image->getInternalTextureFormat(), image->getPixelFormat(), GL_HALF_FLOAT, reinterpret_cast<unsigned char*>(data), osg::Image::USE_NEW_DELETE, 1);
+    new_image->setMipmapLevels(mipmapOffsets);
+    new_image->setOrigin(image->getOrigin());
+
+    return new_image;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+//
+//   Block compression
+//
+namespace
+{
+
+using Block = uint8_t[16][4];
+
+int colorDistance(const uint8_t* lhs, const uint8_t* rhs, int numComponents)
+{
+    int distance = 0;
+    for(int c=0; c<numComponents; ++c)
+    {
+        int delta = static_cast<int>(lhs[c]) - static_cast<int>(rhs[c]);
+        distance += delta*delta;
+    }
+    return distance;
+}
+
+// principal axis of the block's colours, found with a few power iterations on the covariance matrix
+void principalAxis(const Block& block, int numComponents, float mean[4], float axis[4])
+{
+    float covariance[4][4] = {};
+    for(int c=0; c<4; ++c) mean[c] = 0.0f;
+    for(auto& texel : block)
+    {
+        for(int c=0; c<numComponents; ++c) mean[c] += texel[c]/16.0f;
+    }
+    for(auto& texel : block)
+    {
+        float d[4] = {};
+        for(int c=0; c<numComponents; ++c) d[c] = texel[c] - mean[c];
+        for(int i=0; i<numComponents; ++i)
+            for(int j=0; j<numComponents; ++j)
+                covariance[i][j] += d[i]*d[j];
+    }
+
+    // start from the direction of greatest variance so the iteration converges quickly
+    for(int c=0; c<4; ++c) axis[c] = (c<numComponents) ? covariance[c][c] : 0.0f;
+    for(int iteration=0; iteration<8; ++iteration)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for(int i=0; i<numComponents; ++i)
+        {
+            for(int j=0; j<numComponents; ++j) next[i] += covariance[i][j]*axis[j];
+            length = std::max(length, std::abs(next[i]));
+        }
+        if (length==0.0f) break;
+        for(int i=0; i<numComponents; ++i) axis[i] = next[i]/length;
+    }
+}
+
+// endpoints at the extremes of the block's colours along the principal axis
+void axisEndpoints(const Block& block, int numComponents, float e0[4], float e1[4])
+{
+    float mean[4], axis[4];
+    principalAxis(block, numComponents, mean, axis);
+
+    float minProjection = 0.0f, maxProjection = 0.0f;
+    float axisLength2 = 0.0f;
+    for(int c=0; c<numComponents; ++c) axisLength2 += axis[c]*axis[c];
+    if (axisLength2>0.0f)
+    {
+        minProjection = maxProjection = 0.0f;
+        bool first = true;
+        for(auto& texel : block)
+        {
+            float projection = 0.0f;
+            for(int c=0; c<numComponents; ++c) projection += (texel[c]-mean[c])*axis[c];
+            projection /= axisLength2;
+            if (first || projection<minProjection) minProjection = projection;
+            if (first || projection>maxProjection) maxProjection = projection;
+            first = false;
+        }
+    }
+
+    for(int c=0; c<4; ++c)
+    {
+        e0[c] = std::clamp(mean[c] + axis[c]*maxProjection, 0.0f, 255.0f);
+        e1[c] = std::clamp(mean[c] + axis[c]*minProjection, 0.0f, 255.0f);
+    }
+}
+
+// endpoints at the corners of the block's bounding box, inset slightly to reduce the error of the interpolated colours
+void boundingBoxEndpoints(const Block& block, int numComponents, float e0[4], float e1[4])
+{
+    float minColor[4] = {255.0f, 255.0f, 255.0f, 255.0f};
+    float maxColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for(auto& texel : block)
+    {
+        for(int c=0; c<numComponents; ++c)
+        {
+            minColor[c] = std::min(minColor[c], static_cast<float>(texel[c]));
+            maxColor[c] = std::max(maxColor[c], static_cast<float>(texel[c]));
+        }
+    }
+
+    // pick the diagonal of the box that best follows the colour distribution
+    float mean[4] = {};
+    for(auto& texel : block)
+        for(int c=0; c<numComponents; ++c) mean[c] += texel[c]/16.0f;
+
+    for(int c=1; c<numComponents; ++c)
+    {
+        float covariance = 0.0f;
+        for(auto& texel : block) covariance += (texel[0]-mean[0])*(texel[c]-mean[c]);
+        if (covariance<0.0f) std::swap(minColor[c], maxColor[c]);
+    }
+
+    for(int c=0; c<4; ++c)
+    {
+        float inset = (maxColor[c]-minColor[c])/16.0f;
+        e0[c] = maxColor[c] - inset;
+        e1[c] = minColor[c] + inset;
+    }
+}
+
+uint16_t packRGB565(const float color[4])
+{
+    auto r = static_cast<uint16_t>(std::lround(color[0]*31.0f/255.0f));
+    auto g = static_cast<uint16_t>(std::lround(color[1]*63.0f/255.0f));
+    auto b = static_cast<uint16_t>(std::lround(color[2]*31.0f/255.0f));
+    return static_cast<uint16_t>((r<<11) | (g<<5) | b);
+}
+
+void unpackRGB565(uint16_t packed, uint8_t color[4])
+{
+    uint8_t r = (packed>>11) & 31, g = (packed>>5) & 63, b = packed & 31;
+    color[0] = static_cast<uint8_t>((r<<3) | (r>>2));
+    color[1] = static_cast<uint8_t>((g<<2) | (g>>4));
+    color[2] = static_cast<uint8_t>((b<<3) | (b>>2));
+    color[3] = 255;
+}
+
+// choose the closest of the four colours for each texel, returning the total squared error
+int bc1Indices(const Block& block, uint16_t c0, uint16_t c1, uint32_t& indices)
+{
+    uint8_t palette[4][4];
+    unpackRGB565(c0, palette[0]);
+    unpackRGB565(c1, palette[1]);
+    for(int c=0; c<3; ++c)
+    {
+        palette[2][c] = static_cast<uint8_t>((2*palette[0][c] + palette[1][c] + 1)/3);
+        palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2*palette[1][c] + 1)/3);
+    }
+
+    int error = 0;
+    indices = 0;
+    for(int i=0; i<16; ++i)
+    {
+        int best = 0;
+        int bestDistance = colorDistance(block[i], palette[0], 3);
+        for(int p=1; p<4; ++p)
+        {
+            int distance = colorDistance(block[i], palette[p], 3);
+            if (distance<bestDistance) { best = p; bestDistance = distance; }
+        }
+        indices |= static_cast<uint32_t>(best) << (i*2);
+        error += bestDistance;
+    }
+    return error;
+}
+
+int encodeBC1Endpoints(const Block& block, const float e0[4], const float e1[4], uint16_t& c0, uint16_t& c1, uint32_t& indices)
+{
+    c0 = packRGB565(e0);
+    c1 = packRGB565(e1);
+
+    // c0>c1 selects the four colour mode, so swap and remap the indices if required
+    if (c0<c1) std::swap(c0, c1);
+    if (c0==c1)
+    {
+        if (c1>0) --c1;
+        else ++c0;
+    }
+
+    return bc1Indices(block, c0, c1, indices);
+}
+
+// least squares fit of the endpoints to the current index assignment
+bool refitEndpoints(const Block& block, int numComponents, const uint8_t* selectors, const float* weights, float e0[4], float e1[4])
+{
+    float alpha2 = 0.0f, beta2 = 0.0f, alphaBeta = 0.0f;
+    float alphaX[4] = {}, betaX[4] = {};
+    for(int i=0; i<16; ++i)
+    {
+        float beta = weights[selectors[i]];
+        float alpha = 1.0f - beta;
+        alpha2 += alpha*alpha;
+        beta2 += beta*beta;
+        alphaBeta += alpha*beta;
+        for(int c=0; c<numComponents; ++c)
+        {
+            alphaX[c] += alpha*block[i][c];
+            betaX[c] += beta*block[i][c];
+        }
+    }
+
+    float denominator = alpha2*beta2 - alphaBeta*alphaBeta;
+    if (std::abs(denominator)<1e-6f) return false;
+
+    float factor = 1.0f/denominator;
+    for(int c=0; c<numComponents; ++c)
+    {
+        e0[c] = std::clamp((alphaX[c]*beta2 - betaX[c]*alphaBeta)*factor, 0.0f, 255.0f);
+        e1[c] = std::clamp((betaX[c]*alpha2 - alphaX[c]*alphaBeta)*factor, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+void encodeBC1(const Block& block, bool quality, uint8_t* dst)
+{
+    float e0[4], e1[4];
+    if (quality) axisEndpoints(block, 3, e0, e1);
+    else boundingBoxEndpoints(block, 3, e0, e1);
+
+    uint16_t c0, c1;
+    uint32_t indices;
+    int error = encodeBC1Endpoints(block, e0, e1, c0, c1, indices);
+
+    if (quality && error>0)
+    {
+        // weight of the second endpoint for each of the index values
+        static const float s_weights[4] = {0.0f, 1.0f, 1.0f/3.0f, 2.0f/3.0f};
+        uint8_t selectors[16];
+        for(int i=0; i<16; ++i) selectors[i] = (indices>>(i*2)) & 3;
+
+        uint16_t refit_c0, refit_c1;
+        uint32_t refit_indices;
+        if (refitEndpoints(block, 3, selectors, s_weights, e0, e1) &&
+            encodeBC1Endpoints(block, e0, e1, refit_c0, refit_c1, refit_indices)<error)
+        {
+            c0 = refit_c0;
+            c1 = refit_c1;
+            indices = refit_indices;
+        }
+    }
+
+    dst[0] = c0 & 0xff; dst[1] = c0 >> 8;
+    dst[2] = c1 & 0xff; dst[3] = c1 >> 8;
+    for(int i=0; i<4; ++i) dst[4+i] = (indices >> (i*8)) & 0xff;
+}
+
+// single channel block, as used by BC4, BC5 and the alpha of BC3
+void encodeBC4(const Block& block, int channel, uint8_t* dst)
+{
+    uint8_t minValue = 255, maxValue = 0;
+    for(auto& texel : block)
+    {
+        minValue = std::min(minValue, texel[channel]);
+        maxValue = std::max(maxValue, texel[channel]);
+    }
+
+    // a0>a1 selects the eight value mode
+    dst[0] = maxValue;
+    dst[1] = minValue;
+
+    uint64_t indices = 0;
+    if (maxValue>minValue)
+    {
+        int range = maxValue - minValue;
+        for(int i=0; i<16; ++i)
+        {
+            // position along the ramp in sevenths, then mapped to the index ordering {a0, a1, 6 interpolated values}
+            int step = ((maxValue - block[i][channel])*7 + range/2)/range;
+            uint64_t index = (step==0) ? 0 : (step==7) ? 1 : static_cast<uint64_t>(step+1);
+            indices |= index << (i*3);
+        }
+    }
+
+    for(int i=0; i<6; ++i) dst[2+i] = (indices >> (i*8)) & 0xff;
+}
+
+// BC7 mode 6, a single RGBA subset with 7 bit endpoints plus a shared p-bit per endpoint and 4 bit indices
+void encodeBC7(const Block& block, bool quality, uint8_t* dst)
+{
+    static const int s_weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    auto quantize = [](const float e[4], uint8_t q[4], uint8_t& pbit)
+    {
+        // choose the p-bit that gives the smallest error over all four channels
+        float bestError = 0.0f;
+        for(uint8_t p=0; p<2; ++p)
+        {
+            uint8_t candidate[4];
+            float error = 0.0f;
+            for(int c=0; c<4; ++c)
+            {
+                int v = std::clamp(static_cast<int>(std::lround((e[c]-p)/2.0f)), 0, 127);
+                candidate[c] = static_cast<uint8_t>(v);
+                float delta = static_cast<float>((v<<1)|p) - e[c];
+                error += delta*delta;
+            }
+            if (p==0 || error<bestError)
+            {
+                bestError = error;
+                pbit = p;
+                for(int c=0; c<4; ++c) q[c] = candidate[c];
+            }
+        }
+    };
+
+    auto computeIndices = [&block](const uint8_t q0[4], uint8_t p0, const uint8_t q1[4], uint8_t p1, uint8_t indices[16])
+    {
+        uint8_t palette[16][4];
+        for(int i=0; i<16; ++i)
+        {
+            for(int c=0; c<4; ++c)
+            {
+                int a = (q0[c]<<1)|p0, b = (q1[c]<<1)|p1;
+                palette[i][c] = static_cast<uint8_t>(((64-s_weights[i])*a + s_weights[i]*b + 32) >> 6);
+            }
+        }
+
+        int error = 0;
+        for(int i=0; i<16; ++i)
+        {
+            int bestDistance = colorDistance(block[i], palette[0], 4);
+            indices[i] = 0;
+            for(uint8_t p=1; p<16; ++p)
+            {
+                int distance = colorDistance(block[i], palette[p], 4);
+                if (distance<bestDistance) { indices[i] = p; bestDistance = distance; }
+            }
+            error += bestDistance;
+        }
+        return error;
+    };
+
+    float e0[4], e1[4];
+    if (quality) axisEndpoints(block, 4, e0, e1);
+    else boundingBoxEndpoints(block, 4, e0, e1);
+
+    uint8_t q0[4], q1[4], p0, p1;
+    uint8_t indices[16];
+    quantize(e0, q0, p0);
+    quantize(e1, q1, p1);
+    int error = computeIndices(q0, p0, q1, p1, indices);
+
+    if (quality && error>0)
+    {
+        float weights[16];
+        for(int i=0; i<16; ++i) weights[i] = s_weights[i]/64.0f;
+
+        uint8_t refit_q0[4], refit_q1[4], refit_p0, refit_p1;
+        uint8_t refit_indices[16];
+        if (refitEndpoints(block, 4, indices, weights, e0, e1))
+        {
+            quantize(e0, refit_q0, refit_p0);
+            quantize(e1, refit_q1, refit_p1);
+            if (computeIndices(refit_q0, refit_p0, refit_q1, refit_p1, refit_indices)<error)
+            {
+                std::copy(refit_q0, refit_q0+4, q0);
+                std::copy(refit_q1, refit_q1+4, q1);
+                std::copy(refit_indices, refit_indices+16, indices);
+                p0 = refit_p0;
+                p1 = refit_p1;
+            }
+        }
+    }
+
+    // the most significant bit of the first index is implicitly zero, so swap the endpoints if required
+    if (indices[0]>=8)
+    {
+        std::swap_ranges(q0, q0+4, q1);
+        std::swap(p0, p1);
+        for(auto& index : indices) index = 15-index;
+    }
+
+    uint64_t bits[2] = {0, 0};
+    int position = 0;
+    auto write = [&](uint64_t value, int numBits)
+    {
+        for(int b=0; b<numBits; ++b, ++position)
+        {
+            if (value & (uint64_t(1)<<b)) bits[position/64] |= uint64_t(1) << (position%64);
+        }
+    };
+
+    write(1<<6, 7);
+    for(int c=0; c<4; ++c)
+    {
+        write(q0[c], 7);
+        write(q1[c], 7);
+    }
+    write(p0, 1);
+    write(p1, 1);
+    write(indices[0], 3);
+    for(int i=1; i<16; ++i) write(indices[i], 4);
+
+    for(int i=0; i<16; ++i) dst[i] = (bits[i/8] >> ((i%8)*8)) & 0xff;
+}
+
+bool hasTranslucentTexels(const osg::Image* image)
+{
+    for(int t=0; t<image->t(); ++t)
+    {
+        const unsigned char* row = image->data(0, t, 0);
+        for(int s=0; s<image->s(); ++s)
+        {
+            if (row[s*4+3]!=255) return true;
+        }
+    }
+    return false;
+}
+
+} // end of anonymous namespace
+
+AlphaStatistics computeAlphaStatistics(const osg::Image* image, TextureRole role)
+{
+    AlphaStatistics unknown{0.0f, 1.0f, false};
+    if (!image) return AlphaStatistics(); // replaced by a white texture
+
+    if (image->isCompressed() || !image->data()) return unknown;
+
+    // opacity maps are sampled from the red channel, colour maps from the alpha channel
+    int component = -1;
+    switch(image->getPixelFormat())
+    {
+        case(GL_RED):
+        case(GL_LUMINANCE): component = (role==TEXTURE_ROLE_OPACITY) ? 0 : -1; break;
+        case(GL_ALPHA): component = 0; break;
+        case(GL_LUMINANCE_ALPHA): component = (role==TEXTURE_ROLE_OPACITY) ? 0 : 1; break;
+        case(GL_RGB): component = (role==TEXTURE_ROLE_OPACITY) ? 0 : -1; break;
+        case(GL_BGR): component = (role==TEXTURE_ROLE_OPACITY) ? 2 : -1; break;
+        case(GL_RGBA): component = (role==TEXTURE_ROLE_OPACITY) ? 0 : 3; break;
+        case(GL_BGRA): component = (role==TEXTURE_ROLE_OPACITY) ? 2 : 3; break;
+        default: return unknown;
+    }
+
+    if (component<0) return AlphaStatistics();
+
+    GLenum dataType = image->getDataType();
+    if (dataType!=GL_UNSIGNED_BYTE && dataType!=GL_UNSIGNED_SHORT && dataType!=GL_FLOAT) return unknown;
+
+    size_t pixelSize = osg::Image::computePixelSizeInBits(image->getPixelFormat(), dataType)/8;
+    size_t componentSize = (dataType==GL_UNSIGNED_BYTE) ? 1 : ((dataType==GL_UNSIGNED_SHORT) ? 2 : 4);
+
+    AlphaStatistics stats{1.0f, 0.0f, true};
+    for(int r=0; r<image->r(); ++r)
+    {
+        for(int t=0; t<image->t(); ++t)
+        {
+            const unsigned char* src = image->data(0, t, r) + component*componentSize;
+            for(int s=0; s<image->s(); ++s, src += pixelSize)
+            {
+                float value = 0.0f;
+                switch(dataType)
+                {
+                    case(GL_UNSIGNED_BYTE): value = static_cast<float>(*src)/255.0f; break;
+                    case(GL_UNSIGNED_SHORT): value = static_cast<float>(*reinterpret_cast<const uint16_t*>(src))/65535.0f; break;
+                    default: value = *reinterpret_cast<const float*>(src); break;
+                }
+
+                stats.minAlpha = std::min(stats.minAlpha, value);
+                stats.maxAlpha = std::max(stats.maxAlpha, value);
+                if (value!=0.0f && value<1.0f) stats.binary = false;
+            }
+        }
+    }
+
+    return stats;
+}
+
+vsg::ref_ptr<vsg::Data> compressImage(const osg::Image* image, TextureRole role, TextureCompression compression)
+{
+    if (!image || compression==TEXTURE_COMPRESSION_NONE || image->isCompressed() || image->r()!=1 || image->getDataType()!=GL_UNSIGNED_BYTE)
+    {
+        return {};
+    }
+
+    // the level 0 dimensions must be a whole number of blocks, smaller mipmap levels are padded as the formats allow
+    if ((image->s()%4)!=0 || (image->t()%4)!=0)
+    {
+        return {};
+    }
+
+    int numComponents = 0;
+    switch(image->getPixelFormat())
+    {
+        case(GL_RED):
+        case(GL_LUMINANCE):
+        case(GL_ALPHA): numComponents = 1; break;
+        case(GL_LUMINANCE_ALPHA): numComponents = 2; break;
+        case(GL_RGB): numComponents = 3; break;
+        case(GL_RGBA): numComponents = 4; break;
+        default: return {};
+    }
+
+    bool quality = (compression==TEXTURE_COMPRESSION_QUALITY);
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t blockSize = 128;
+    if (role==TEXTURE_ROLE_OPACITY || numComponents==1)
+    {
+        // single channel maps are sampled from the red channel
+        format = VK_FORMAT_BC4_UNORM_BLOCK;
+        blockSize = 64;
+    }
+    else if (role==TEXTURE_ROLE_NORMAL || numComponents==2)
+    {
+        // normal maps keep x and y, z is reconstructed in the fragment shader
+        format = VK_FORMAT_BC5_UNORM_BLOCK;
+    }
+    else if (quality)
+    {
+        format = VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+    else if (numComponents==4 && hasTranslucentTexels(image))
+    {
+        format = VK_FORMAT_BC3_UNORM_BLOCK;
+    }
+    else
+    {
+        format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        blockSize = 64;
+    }
+
+    int numLevels = static_cast<int>(image->getNumMipmapLevels());
+    size_t bytesPerBlock = blockSize/8;
+    size_t totalSize = 0;
+    for(int level=0; level<numLevels; ++level)
+    {
+        size_t blocksWide = (std::max(image->s()>>level, 1)+3)/4;
+        size_t blocksHigh = (std::max(image->t()>>level, 1)+3)/4;
+        totalSize += blocksWide*blocksHigh*bytesPerBlock;
+    }
+
+    uint8_t* data = new uint8_t[totalSize];
+    uint8_t* dst = data;
+    for(int level=0; level<numLevels; ++level)
+    {
+        int width = std::max(image->s()>>level, 1);
+        int height = std::max(image->t()>>level, 1);
+        const unsigned char* levelData = image->getMipmapData(level);
+        size_t rowSize = static_cast<size_t>(width)*numComponents;
+        if (level==0) rowSize = image->getRowStepInBytes();
+
+        for(int by=0; by<height; by+=4)
+        {
+            for(int bx=0; bx<width; bx+=4)
+            {
+                // gather the block, clamping to the edge of levels smaller than a block
+                Block block;
+                for(int y=0; y<4; ++y)
+                {
+                    const unsigned char* row = levelData + std::min(by+y, height-1)*rowSize;
+                    for(int x=0; x<4; ++x)
+                    {
+                        const unsigned char* texel = row + std::min(bx+x, width-1)*numComponents;
+                        uint8_t* value = block[y*4+x];
+                        switch(numComponents)
+                        {
+                            case(1): value[0] = texel[0]; value[1] = texel[0]; value[2] = texel[0]; value[3] = 255; break;
+                            case(2): value[0] = texel[0]; value[1] = texel[1]; value[2] = 0; value[3] = 255; break;
+                            case(3): value[0] = texel[0]; value[1] = texel[1]; value[2] = texel[2]; value[3] = 255; break;
+                            default: value[0] = texel[0]; value[1] = texel[1]; value[2] = texel[2]; value[3] = texel[3]; break;
+                        }
+                    }
+                }
+
+                switch(format)
+                {
+                    case(VK_FORMAT_BC1_RGB_UNORM_BLOCK):
+                        encodeBC1(block, quality, dst);
+                        break;
+                    case(VK_FORMAT_BC3_UNORM_BLOCK):
+                        encodeBC4(block, 3, dst);
+                        encodeBC1(block, quality, dst+8);
+                        break;
+                    case(VK_FORMAT_BC4_UNORM_BLOCK):
+                        encodeBC4(block, 0, dst);
+                        break;
+                    case(VK_FORMAT_BC5_UNORM_BLOCK):
+                        encodeBC4(block, 0, dst);
+                        encodeBC4(block, 1, dst+8);
+                        break;
+                    default:
+                        encodeBC7(block, quality, dst);
+                        break;
+                }
+                dst += bytesPerBlock;
+            }
+        }
+    }
+
+    vsg::Data::Layout layout;
+    layout.format = format;
+    layout.blockWidth = 4;
+    layout.blockHeight = 4;
+    layout.maxNumMipmaps = numLevels;
     layout.origin = (image->getOrigin()==osg::Image::BOTTOM_LEFT) ? vsg::BOTTOM_LEFT : vsg::TOP_LEFT;
 
+    uint32_t width = image->s()/4;
+    uint32_t height = image->t()/4;
+
+    vsg::ref_ptr<vsg::Data> vsg_data;
+    if (blockSize==64) vsg_data = new vsg::block64Array2D(width, height, reinterpret_cast<vsg::block64*>(data));
+    else vsg_data = new vsg::block128Array2D(width, height, reinterpret_cast<vsg::block128*>(data));
+
     vsg_data->setLayout(layout);
 
     return vsg_data;
 }
 
+bool normalMapKeepsOnlyXY(const osg::Image* image, TextureCompression compression)
+{
+    if (!image) return false;
+
+    switch(image->getPixelFormat())
+    {
+        case(GL_COMPRESSED_RED_GREEN_RGTC2_EXT):
+        case(GL_LUMINANCE_ALPHA):
+            return true;
+        default:
+            break;
+    }
+
+    // compressImage() stores 8 bit normal maps as BC5, the images it can't compress keep z
+    return compression!=TEXTURE_COMPRESSION_NONE && !image->isCompressed() && image->getDataType()==GL_UNSIGNED_BYTE;
+}
+
 template<typename T>
-vsg::ref_ptr<vsg::Data> create(osg::ref_ptr<osg::Image> image, VkFormat format)
+vsg::ref_ptr<vsg::Data> create(osg::Image* image, VkFormat format, bool allowMove)
 {
+    int width = image->s();
+    int height = image->t();
+    int depth = image->r();
+    auto data = reinterpret_cast<T*>(releaseImageData(image, allowMove));
+
     vsg::ref_ptr<vsg::Data> vsg_data;
-    if (image->r()==1)
+    if (depth==1)
     {
-        vsg_data = vsg::Array2D<T>::create(image->s(), image->t(), reinterpret_cast<T*>(image->data()), vsg::Data::Layout{format});
+        vsg_data = vsg::Array2D<T>::create(width, height, data, vsg::Data::Layout{format});
     }
     else
     {
-        vsg_data = vsg::Array3D<T>::create(image->s(), image->t(), image->r(), reinterpret_cast<T*>(image->data()), vsg::Data::Layout{format});
+        vsg_data = vsg::Array3D<T>::create(width, height, depth, data, vsg::Data::Layout{format});
     }
 
     return vsg_data;
 }
 
-vsg::ref_ptr<vsg::Data> convertToVsg(const osg::Image* image)
+vsg::ref_ptr<vsg::Data> convertImage(osg::ref_ptr<osg::Image> image, const ImageOptions& options, bool allowMove)
 {
     if (!image)
     {
         return createWhiteTexture();
     }
 
+    allowMove = allowMove || options.releaseSource;
+
     if (image->isCompressed())
     {
-        return convertCompressedImageToVsg(image);
+        return convertCompressedImageToVsg(image.get(), allowMove);
     }
 
+    GLenum dataType = image->getDataType();
+    auto origin = image->getOrigin();
+
     int numComponents = 4;
     osg::ref_ptr<osg::Image> new_image;
 
@@ -363,35 +1467,39 @@ vsg::ref_ptr<vsg::Data> convertToVsg(const osg::Image* image)
         case(GL_LUMINANCE):
         case(GL_ALPHA):
             numComponents = 1;
-            new_image = const_cast<osg::Image*>(image);
+            new_image = formatImage(image.get(), image->getPixelFormat());
             break;
         case(GL_LUMINANCE_ALPHA):
             numComponents = 2;
-            new_image = const_cast<osg::Image*>(image);
-            break;
-#if 1
-        case(GL_RGB):
-        case(GL_BGR):
-            // current NVidia driver doesn't supprt RGB so expand to RGBA
-            numComponents = 4;
-            new_image = formatImage(image, GL_RGBA);
+            new_image = formatImage(image.get(), image->getPixelFormat());
             break;
-#else
         case(GL_RGB):
-            numComponents = 3;
-            new_image = const_cast<osg::Image*>(image);
         case(GL_BGR):
-            numComponents = 3;
-            new_image = formatImage(image, GL_RGB);
+            if (options.allowRGB && dataType==GL_UNSIGNED_BYTE)
+            {
+                numComponents = 3;
+                new_image = formatImage(image.get(), GL_RGB);
+            }
+            else
+            {
+                // not all drivers support sampling RGB formats so expand to RGBA unless the target device is known to
+                numComponents = 4;
+                new_image = formatImage(image.get(), GL_RGBA);
+            }
             break;
-#endif
         case(GL_RGBA):
-            numComponents = 4;
-            new_image = const_cast<osg::Image*>(image);
-            break;
         case(GL_BGRA):
-            numComponents = 4;
-            new_image = formatImage(image, GL_RGBA);
+            if (options.dropOpaqueAlpha && options.allowRGB && dataType==GL_UNSIGNED_BYTE && computeAlphaStatistics(image.get(), TEXTURE_ROLE_COLOR).opaque())
+            {
+                // alpha is 1.0 everywhere, which is what sampling an RGB image returns, so the channel can be dropped
+                numComponents = 3;
+                new_image = formatImage(image.get(), GL_RGB);
+            }
+            else
+            {
+                numComponents = 4;
+                new_image = formatImage(image.get(), GL_RGBA);
+            }
             break;
         default:
             std::cout<<"Warning: convertToVsg(osg::Image*) does not support image->getPixelFormat() == "<<std::hex<<image->getPixelFormat()<<std::endl;
@@ -404,48 +1512,131 @@ vsg::ref_ptr<vsg::Data> convertToVsg(const osg::Image* image)
         return {};
     }
 
-    // we want to pass ownership of the new_image data onto th vsg_image so reset the allocation mode on the image to prevent deletetion.
-    new_image->setAllocationMode(osg::Image::NO_DELETE);
+    // images created during conversion are always ours to move, the source image only when the caller has allowed it.
+    // our reference to the source is dropped so it doesn't count as sharing the image.
+    bool moveData = allowMove || new_image!=image;
+    image = nullptr;
+
+    // downscale before mipmap generation and compression so they work on the smaller image
+    if (options.maxDimension>0)
+    {
+        auto downscaled = downscaleImage(new_image, options.maxDimension, options.mipmapFilter, options.sRGB);
+        if (downscaled!=new_image) moveData = true;
+        new_image = downscaled;
+    }
+
+    if (options.mipmapFilter!=MIPMAP_FILTER_NONE && !new_image->isMipmap())
+    {
+        auto mipmapped = generateMipmaps(new_image, options.mipmapFilter, options.sRGB);
+        if (mipmapped!=new_image) moveData = true;
+        new_image = mipmapped;
+    }
+
+    if (options.compression!=TEXTURE_COMPRESSION_NONE)
+    {
+        if (auto compressed = compressImage(new_image, options.role, options.compression)) return compressed;
+    }
+
+    if (options.halfFloat && dataType==GL_FLOAT)
+    {
+        new_image = convertToHalfFloat(new_image);
+        dataType = GL_HALF_FLOAT;
+        moveData = true;
+    }
+
+    // read before the data is released as that may leave new_image empty
+    auto numMipmaps = new_image->getNumMipmapLevels();
 
     vsg::ref_ptr<vsg::Data> vsg_data;
 
     switch(numComponents)
     {
         case(1):
-            if (image->getDataType()==GL_UNSIGNED_BYTE) vsg_data = create<uint8_t>(new_image, VK_FORMAT_R8_UNORM);
-            else if (image->getDataType()==GL_UNSIGNED_SHORT) vsg_data = create<uint16_t>(new_image, VK_FORMAT_R16_UNORM);
-            else if (image->getDataType()==GL_UNSIGNED_INT) vsg_data = create<uint32_t>(new_image, VK_FORMAT_R32_UINT);
-            else if (image->getDataType()==GL_FLOAT) vsg_data = create<float>(new_image, VK_FORMAT_R32_SFLOAT);
-            else if (image->getDataType()==GL_DOUBLE) vsg_data = create<double>(new_image, VK_FORMAT_R64_SFLOAT);
+            if (dataType==GL_UNSIGNED_BYTE) vsg_data = create<uint8_t>(new_image.get(), VK_FORMAT_R8_UNORM, moveData);
+            else if (dataType==GL_UNSIGNED_SHORT) vsg_data = create<uint16_t>(new_image.get(), VK_FORMAT_R16_UNORM, moveData);
+            else if (dataType==GL_UNSIGNED_INT) vsg_data = create<uint32_t>(new_image.get(), VK_FORMAT_R32_UINT, moveData);
+            else if (dataType==GL_HALF_FLOAT) vsg_data = create<uint16_t>(new_image.get(), VK_FORMAT_R16_SFLOAT, moveData);
+            else if (dataType==GL_FLOAT) vsg_data = create<float>(new_image.get(), VK_FORMAT_R32_SFLOAT, moveData);
+            else if (dataType==GL_DOUBLE) vsg_data = create<double>(new_image.get(), VK_FORMAT_R64_SFLOAT, moveData);
             break;
         case(2):
-            if (image->getDataType()==GL_UNSIGNED_BYTE) vsg_data = create<vsg::ubvec2>(new_image, VK_FORMAT_R8G8_UNORM);
-            else if (image->getDataType()==GL_UNSIGNED_SHORT) vsg_data = create<vsg::usvec2>(new_image, VK_FORMAT_R16G16_UNORM);
-            else if (image->getDataType()==GL_UNSIGNED_INT) vsg_data = create<vsg::uivec2>(new_image, VK_FORMAT_R32G32_UINT);
-            else if (image->getDataType()==GL_FLOAT) vsg_data = create<vsg::vec2>(new_image, VK_FORMAT_R32G32_SFLOAT);
-            else if (image->getDataType()==GL_DOUBLE) vsg_data = create<vsg::dvec2>(new_image, VK_FORMAT_R64G64_SFLOAT);
+            if (dataType==GL_UNSIGNED_BYTE) vsg_data = create<vsg::ubvec2>(new_image.get(), VK_FORMAT_R8G8_UNORM, moveData);
+            else if (dataType==GL_UNSIGNED_SHORT) vsg_data = create<vsg::usvec2>(new_image.get(), VK_FORMAT_R16G16_UNORM, moveData);
+            else if (dataType==GL_UNSIGNED_INT) vsg_data = create<vsg::uivec2>(new_image.get(), VK_FORMAT_R32G32_UINT, moveData);
+            else if (dataType==GL_HALF_FLOAT) vsg_data = create<vsg::usvec2>(new_image.get(), VK_FORMAT_R16G16_SFLOAT, moveData);
+            else if (dataType==GL_FLOAT) vsg_data = create<vsg::vec2>(new_image.get(), VK_FORMAT_R32G32_SFLOAT, moveData);
+            else if (dataType==GL_DOUBLE) vsg_data = create<vsg::dvec2>(new_image.get(), VK_FORMAT_R64G64_SFLOAT, moveData);
             break;
         case(3):
-            if (image->getDataType()==GL_UNSIGNED_BYTE) vsg_data = create<vsg::ubvec3>(new_image, VK_FORMAT_R8G8B8_UNORM);
-            else if (image->getDataType()==GL_UNSIGNED_SHORT) vsg_data = create<vsg::usvec3>(new_image, VK_FORMAT_R16G16B16_UNORM);
-            else if (image->getDataType()==GL_UNSIGNED_INT) vsg_data = create<vsg::uivec3>(new_image, VK_FORMAT_R32G32B32_UINT);
-            else if (image->getDataType()==GL_FLOAT) vsg_data = create<vsg::vec3>(new_image, VK_FORMAT_R32G32B32_SFLOAT);
-            else if (image->getDataType()==GL_DOUBLE) vsg_data = create<vsg::dvec3>(new_image, VK_FORMAT_R64G64B64_SFLOAT);
+            if (dataType==GL_UNSIGNED_BYTE) vsg_data = create<vsg::ubvec3>(new_image.get(), VK_FORMAT_R8G8B8_UNORM, moveData);
+            else if (dataType==GL_UNSIGNED_SHORT) vsg_data = create<vsg::usvec3>(new_image.get(), VK_FORMAT_R16G16B16_UNORM, moveData);
+            else if (dataType==GL_UNSIGNED_INT) vsg_data = create<vsg::uivec3>(new_image.get(), VK_FORMAT_R32G32B32_UINT, moveData);
+            else if (dataType==GL_FLOAT) vsg_data = create<vsg::vec3>(new_image.get(), VK_FORMAT_R32G32B32_SFLOAT, moveData);
+            else if (dataType==GL_DOUBLE) vsg_data = create<vsg::dvec3>(new_image.get(), VK_FORMAT_R64G64B64_SFLOAT, moveData);
             break;
         case(4):
-            if (image->getDataType()==GL_UNSIGNED_BYTE) vsg_data = create<vsg::ubvec4>(new_image, VK_FORMAT_R8G8B8A8_UNORM);
-            else if (image->getDataType()==GL_UNSIGNED_SHORT) vsg_data = create<vsg::usvec4>(new_image, VK_FORMAT_R16G16B16A16_UNORM);
-            else if (image->getDataType()==GL_UNSIGNED_INT) vsg_data = create<vsg::uivec4>(new_image, VK_FORMAT_R32G32B32A32_UINT);
-            else if (image->getDataType()==GL_FLOAT) vsg_data = create<vsg::vec4>(new_image, VK_FORMAT_R32G32B32A32_SFLOAT);
-            else if (image->getDataType()==GL_DOUBLE) vsg_data = create<vsg::dvec4>(new_image, VK_FORMAT_R64G64B64A64_SFLOAT);
+            if (dataType==GL_UNSIGNED_BYTE) vsg_data = create<vsg::ubvec4>(new_image.get(), VK_FORMAT_R8G8B8A8_UNORM, moveData);
+            else if (dataType==GL_UNSIGNED_SHORT) vsg_data = create<vsg::usvec4>(new_image.get(), VK_FORMAT_R16G16B16A16_UNORM, moveData);
+            else if (dataType==GL_UNSIGNED_INT) vsg_data = create<vsg::uivec4>(new_image.get(), VK_FORMAT_R32G32B32A32_UINT, moveData);
+            else if (dataType==GL_HALF_FLOAT) vsg_data = create<vsg::usvec4>(new_image.get(), VK_FORMAT_R16G16B16A16_SFLOAT, moveData);
+            else if (dataType==GL_FLOAT) vsg_data = create<vsg::vec4>(new_image.get(), VK_FORMAT_R32G32B32A32_SFLOAT, moveData);
+            else if (dataType==GL_DOUBLE) vsg_data = create<vsg::dvec4>(new_image.get(), VK_FORMAT_R64G64B64A64_SFLOAT, moveData);
             break;
     }
 
+    if (!vsg_data)
+    {
+        std::cout<<"Warning: convertToVsg(osg::Image*) does not support image->getDataType() == "<<std::hex<<dataType<<std::endl;
+        return {};
+    }
+
     vsg::Data::Layout& layout = vsg_data->getLayout();
-    layout.maxNumMipmaps = image->getNumMipmapLevels();
-    layout.origin = (image->getOrigin()==osg::Image::BOTTOM_LEFT) ? vsg::BOTTOM_LEFT : vsg::TOP_LEFT;
+    layout.maxNumMipmaps = numMipmaps;
+    layout.origin = (origin==osg::Image::BOTTOM_LEFT) ? vsg::BOTTOM_LEFT : vsg::TOP_LEFT;
 
     return vsg_data;
 }
 
+void DeviceFormatProfile::apply(ImageOptions& options) const
+{
+    options.allowRGB = supportsRGB();
+    options.halfFloat = supportsHalfFloat();
+}
+
+DeviceFormatProfile DeviceFormatProfile::query(VkPhysicalDevice physicalDevice)
+{
+    static const VkFormat s_candidateFormats[] = {
+        VK_FORMAT_R8G8B8_UNORM,
+        VK_FORMAT_R16_SFLOAT,
+        VK_FORMAT_R16G16_SFLOAT,
+        VK_FORMAT_R16G16B16A16_SFLOAT
+    };
+
+    DeviceFormatProfile profile;
+    for(auto format : s_candidateFormats)
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        if ((properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)!=0) profile.sampledFormats.insert(format);
+    }
+    return profile;
+}
+
+vsg::ref_ptr<vsg::Data> convertToVsg(const osg::Image* image)
+{
+    return convertToVsg(image, ImageOptions());
+}
+
+vsg::ref_ptr<vsg::Data> convertToVsg(const osg::Image* image, const ImageOptions& options)
+{
+    return convertImage(const_cast<osg::Image*>(image), options, false);
+}
+
+vsg::ref_ptr<vsg::Data> moveToVsg(osg::ref_ptr<osg::Image> image, const ImageOptions& options)
+{
+    // images referenced elsewhere are still in use, so are copied
+    bool allowMove = image && image->referenceCount()==1;
+    return convertImage(std::move(image), options, allowMove);
+}
+
 } // end of namespace osg2cpp
@@ -10,6 +10,8 @@
 
 #include <osg/io_utils>
 
+#include <osgUtil/Optimizer>
+
 using namespace osg2vsg;
 
 
@@ -151,3 +153,91 @@ void OptimizeOsgBillboards::optimize()
     }
 
 }
+
+namespace
+{
+    class CountTexturedStateSets : public osg::NodeVisitor
+    {
+    public:
+        CountTexturedStateSets():
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+        struct UniqueStateSet
+        {
+            bool operator() (const osg::StateSet* lhs, const osg::StateSet* rhs) const
+            {
+                return lhs->compare(*rhs)<0;
+            }
+        };
+
+        std::set<const osg::StateSet*, UniqueStateSet> statesets;
+        std::set<const osg::Texture*> textures;
+
+        void add(const osg::StateSet* stateset)
+        {
+            if (!stateset) return;
+
+            bool textured = false;
+            for(unsigned int unit=0; unit<stateset->getNumTextureAttributeLists(); ++unit)
+            {
+                if (auto texture = dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(unit, osg::StateAttribute::TEXTURE)))
+                {
+                    textures.insert(texture);
+                    textured = true;
+                }
+            }
+
+            if (textured) statesets.insert(stateset);
+        }
+
+        void apply(osg::Node& node)
+        {
+            add(node.getStateSet());
+            traverse(node);
+        }
+
+        void apply(osg::Drawable& drawable)
+        {
+            add(drawable.getStateSet());
+        }
+    };
+}
+
+OptimizeOsgTextureAtlases::OptimizeOsgTextureAtlases(unsigned int in_maxAtlasSize):
+    maxAtlasSize(in_maxAtlasSize)
+{
+}
+
+OptimizeOsgTextureAtlases::Counts OptimizeOsgTextureAtlases::count(osg::Node* scene)
+{
+    CountTexturedStateSets counter;
+    if (scene) scene->accept(counter);
+
+    Counts counts;
+    counts.numTexturedStateSets = counter.statesets.size();
+    counts.numTextures = counter.textures.size();
+    return counts;
+}
+
+void OptimizeOsgTextureAtlases::optimize(osg::Node* scene)
+{
+    if (!scene) return;
+
+    before = count(scene);
+
+    osgUtil::Optimizer optimizer;
+
+    // the atlas builder only groups textures whose format, filters and wrap modes match, so samplers are preserved
+    osgUtil::Optimizer::TextureAtlasVisitor tav(&optimizer);
+    tav.getTextureAtlasBuilder().setMaximumAtlasSize(maxAtlasSize, maxAtlasSize);
+    scene->accept(tav);
+    tav.optimize();
+
+    after = count(scene);
+}
+
+void OptimizeOsgTextureAtlases::report(std::ostream& out) const
+{
+    out<<"Texture atlasing : textures "<<before.numTextures<<" -> "<<after.numTextures
+       <<", descriptor set binds "<<before.numTexturedStateSets<<" -> "<<after.numTexturedStateSets<<std::endl;
+}
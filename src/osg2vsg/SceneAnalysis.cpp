@@ -1,5 +1,9 @@
 #include <osg2vsg/SceneAnalysis.h>
 
+#include <osg/Texture>
+#include <osg/Uniform>
+
+#include <numeric>
 
 using namespace osg2vsg;
 
@@ -54,9 +58,94 @@ void SceneStats::print(std::ostream& out)
             out<<"\t"<<objectFrequencyMap.size()<<"\t"<<totalInstances<<"\n";
         }
     }
-    out<<std::endl;
+
+    printMemory(out);
+}
+
+
+const char* SceneStats::getCategoryName(MemoryCategory category)
+{
+    switch(category)
+    {
+        case(VERTEX_DATA): return "vertex";
+        case(INDEX_DATA): return "index";
+        case(TEXTURE_DATA): return "texture";
+        case(UNIFORM_DATA): return "uniform";
+        case(DESCRIPTOR_DATA): return "descriptor";
+        default: return "unknown";
+    }
+}
+
+uint64_t SceneStats::MemoryFootprint::totalCpuBytes() const
+{
+    return std::accumulate(std::begin(cpuBytes), std::end(cpuBytes), uint64_t(0));
+}
+
+uint64_t SceneStats::MemoryFootprint::totalGpuBytes() const
+{
+    return std::accumulate(std::begin(gpuBytes), std::end(gpuBytes), uint64_t(0));
 }
 
+void SceneStats::addMemory(const void* pipeline, const void* data, MemoryCategory category, uint64_t cpuBytes, uint64_t gpuBytes)
+{
+    if (!data) return;
+
+    if (_countedData.insert(data).second)
+    {
+        memory.cpuBytes[category] += cpuBytes;
+        memory.gpuBytes[category] += gpuBytes;
+    }
+
+    auto [itr, inserted] = _pipelineCountedData.emplace(pipeline, std::make_pair(pipelineMemory.size(), std::set<const void*>()));
+    if (inserted) pipelineMemory.emplace_back(pipeline, MemoryFootprint());
+
+    if (itr->second.second.insert(data).second)
+    {
+        auto& footprint = pipelineMemory[itr->second.first].second;
+        footprint.cpuBytes[category] += cpuBytes;
+        footprint.gpuBytes[category] += gpuBytes;
+    }
+}
+
+void SceneStats::printMemory(std::ostream& out)
+{
+    bool hasGpuBytes = memory.totalGpuBytes()>0;
+
+    auto printFootprint = [&](const MemoryFootprint& footprint)
+    {
+        out<<"    category  \tCPU bytes"<<(hasGpuBytes ? "\tGPU bytes" : "")<<"\n";
+        for(int i=0; i<NUM_MEMORY_CATEGORIES; ++i)
+        {
+            if (footprint.cpuBytes[i]==0 && footprint.gpuBytes[i]==0) continue;
+
+            auto name = getCategoryName(static_cast<MemoryCategory>(i));
+            out<<"    "<<name;
+            for(size_t c = strlen(name); c<strlen("category  "); ++c) out<<" ";
+            out<<"\t"<<footprint.cpuBytes[i];
+            if (hasGpuBytes) out<<"\t"<<footprint.gpuBytes[i];
+            out<<"\n";
+        }
+        out<<"    total     \t"<<footprint.totalCpuBytes();
+        if (hasGpuBytes) out<<"\t"<<footprint.totalGpuBytes();
+        out<<"\n";
+    };
+
+    out<<"\nMemory footprint:\n";
+    printFootprint(memory);
+
+    // pipelines are numbered in the order first drawn, the footprint of a pipeline includes data it shares with others
+    if (pipelineMemory.size()>1 || (pipelineMemory.size()==1 && pipelineMemory.front().first))
+    {
+        size_t pipelineNum = 0;
+        for(auto& [pipeline, footprint] : pipelineMemory)
+        {
+            if (pipeline) out<<"\nPipeline "<<pipelineNum++<<" memory footprint:\n";
+            else out<<"\nMemory footprint outside pipelines:\n";
+            printFootprint(footprint);
+        }
+    }
+    out<<std::endl;
+}
 
 ///////////////////////////////////////////////////////////////////////////////////
 //
@@ -90,11 +179,16 @@ void OsgSceneAnalysis::apply(osg::Geometry& geometry)
     for(auto& array : arrayList)
     {
         _sceneStats->insert(array.get());
+        _sceneStats->addMemory(nullptr, array.get(), SceneStats::VERTEX_DATA, array->getTotalDataSize(), 0);
     }
 
     for(auto& primitiveSet : geometry.getPrimitiveSetList())
     {
         _sceneStats->insert(primitiveSet.get());
+        if (auto drawElements = primitiveSet->getDrawElements())
+        {
+            _sceneStats->addMemory(nullptr, drawElements, SceneStats::INDEX_DATA, drawElements->getTotalDataSize(), 0);
+        }
     }
 
 }
@@ -113,12 +207,27 @@ void OsgSceneAnalysis::apply(osg::StateSet& stateset)
         for(auto& attribute : textureList)
         {
             _sceneStats->insert(attribute.second.first.get());
+
+            if (auto texture = attribute.second.first->asTexture())
+            {
+                for(unsigned int i=0; i<texture->getNumImages(); ++i)
+                {
+                    auto image = texture->getImage(i);
+                    if (image) _sceneStats->addMemory(nullptr, image, SceneStats::TEXTURE_DATA, image->getTotalSizeInBytesIncludingMipmaps(), 0);
+                }
+            }
         }
     }
 
     for(auto& uniform : stateset.getUniformList())
     {
         _sceneStats->insert(uniform.second.first.get());
+
+        const osg::Array* arrays[] = { uniform.second.first->getFloatArray(), uniform.second.first->getDoubleArray(), uniform.second.first->getIntArray(), uniform.second.first->getUIntArray() };
+        for(auto array : arrays)
+        {
+            if (array) _sceneStats->addMemory(nullptr, array, SceneStats::UNIFORM_DATA, array->getTotalDataSize(), 0);
+        }
     }
 }
 
@@ -139,19 +248,26 @@ void VsgSceneAnalysis::apply(const vsg::Object& object)
     object.traverse(*this);
 }
 
+void VsgSceneAnalysis::addData(const vsg::Data* data, SceneStats::MemoryCategory category)
+{
+    if (!data) return;
+
+    _sceneStats->insert(data);
+
+    // vertex and index data is copied to the GPU as it is
+    _sceneStats->addMemory(_pipeline, data, category, data->dataSize(), data->dataSize());
+}
+
 void VsgSceneAnalysis::apply(const vsg::Geometry& geometry)
 {
     _sceneStats->insert(&geometry);
 
     for(auto& array : geometry.arrays)
     {
-        _sceneStats->insert(array.get());
+        addData(array.get(), SceneStats::VERTEX_DATA);
     }
 
-    if (geometry.indices)
-    {
-        _sceneStats->insert(geometry.indices.get());
-    }
+    addData(geometry.indices.get(), SceneStats::INDEX_DATA);
 
     for(auto& command : geometry.commands)
     {
@@ -159,26 +275,118 @@ void VsgSceneAnalysis::apply(const vsg::Geometry& geometry)
     }
 }
 
+void VsgSceneAnalysis::apply(const vsg::VertexIndexDraw& vid)
+{
+    _sceneStats->insert(&vid);
+
+    for(auto& array : vid.arrays)
+    {
+        addData(array.get(), SceneStats::VERTEX_DATA);
+    }
+
+    addData(vid.indices.get(), SceneStats::INDEX_DATA);
+}
+
+void VsgSceneAnalysis::apply(const vsg::Commands& commands)
+{
+    _sceneStats->insert(&commands);
+
+    commands.traverse(*this);
+}
+
+void VsgSceneAnalysis::apply(const vsg::BindVertexBuffers& bvb)
+{
+    _sceneStats->insert(&bvb);
+
+    for(auto& array : bvb.getArrays())
+    {
+        addData(array.get(), SceneStats::VERTEX_DATA);
+    }
+}
+
+void VsgSceneAnalysis::apply(const vsg::BindIndexBuffer& bib)
+{
+    _sceneStats->insert(&bib);
+
+    addData(vsg::ref_ptr<const vsg::Data>(bib.getIndices()).get(), SceneStats::INDEX_DATA);
+}
+
 void VsgSceneAnalysis::apply(const vsg::StateGroup& stategroup)
 {
     _sceneStats->insert(&stategroup);
 
+    // the pipeline bound by the stategroup applies to its subgraph only
+    auto parentPipeline = _pipeline;
+
     for(auto& command : stategroup.getStateCommands())
     {
         command->accept(*this);
     }
 
     stategroup.traverse(*this);
+
+    _pipeline = parentPipeline;
 }
 
-#if 0
-void VsgSceneAnalysis::apply(const vsg::Commands& commands) override
+void VsgSceneAnalysis::apply(const vsg::BindGraphicsPipeline& bindPipeline)
 {
-    _sceneStats->insert(&commands);
-    for(auto& command : stategroup.getChildren())
+    _sceneStats->insert(&bindPipeline);
+
+    _pipeline = bindPipeline.pipeline.get();
+
+    bindPipeline.traverse(*this);
+}
+
+void VsgSceneAnalysis::apply(const vsg::DescriptorSet& descriptorSet)
+{
+    _sceneStats->insert(&descriptorSet);
+
+    // each descriptor set takes descriptor pool memory for all of its descriptors, even when the descriptors are shared with other sets
+    _numDescriptors = 0;
+    descriptorSet.traverse(*this);
+
+    _sceneStats->addMemory(_pipeline, &descriptorSet, SceneStats::DESCRIPTOR_DATA, 0, _numDescriptors*descriptorSize);
+    _numDescriptors = 0;
+}
+
+void VsgSceneAnalysis::apply(const vsg::DescriptorImage& descriptorImage)
+{
+    _sceneStats->insert(&descriptorImage);
+
+    for(auto& samplerImage : descriptorImage.getSamplerImages())
     {
-        _sceneStats->insert(command.get());
+        ++_numDescriptors;
+
+        auto& data = samplerImage.data;
+        if (!data) continue;
+
+        _sceneStats->insert(data.get());
+
+        // mipmaps the data doesn't hold are generated when the texture is compiled, adding up to a third to its size
+        uint64_t cpuBytes = data->dataSize();
+        uint64_t gpuBytes = cpuBytes;
+        if (samplerImage.sampler && samplerImage.sampler->maxLod>0.0f && data->getLayout().maxNumMipmaps<=1) gpuBytes += cpuBytes/3;
+
+        _sceneStats->addMemory(_pipeline, data.get(), SceneStats::TEXTURE_DATA, cpuBytes, gpuBytes);
     }
 }
-#endif
 
+void VsgSceneAnalysis::apply(const vsg::DescriptorBuffer& descriptorBuffer)
+{
+    _sceneStats->insert(&descriptorBuffer);
+
+    for(auto& data : descriptorBuffer.getDataList())
+    {
+        ++_numDescriptors;
+
+        if (!data) continue;
+
+        _sceneStats->insert(data.get());
+
+        // each uniform or storage buffer is allocated at the device's offset alignment
+        uint64_t cpuBytes = data->dataSize();
+        uint64_t gpuBytes = ((cpuBytes + uniformAlignment - 1) / uniformAlignment) * uniformAlignment;
+
+        _sceneStats->addMemory(_pipeline, data.get(), SceneStats::UNIFORM_DATA, cpuBytes, gpuBytes);
+    }
+}
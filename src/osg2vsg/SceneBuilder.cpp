@@ -4,6 +4,7 @@
 #include <osg2vsg/GeometryUtils.h>
 #include <osg2vsg/ShaderUtils.h>
 #include <osg2vsg/Optimize.h>
+#include <osg2vsg/CullHierarchy.h>
 
 #include <vsg/nodes/MatrixTransform.h>
 #include <vsg/nodes/CullGroup.h>
@@ -13,6 +14,13 @@
 
 #include <osg/io_utils>
 
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <queue>
+
 using namespace osg2vsg;
 
 #if 0
@@ -22,9 +30,9 @@ using namespace osg2vsg;
 #endif
 
 
-vsg::ref_ptr<vsg::BindGraphicsPipeline> PipelineCache::getOrCreateBindGraphicsPipeline(uint32_t shaderModeMask, uint32_t geometryAttributesMask, const std::string& vertShaderPath, const std::string& fragShaderPath)
+vsg::ref_ptr<vsg::BindGraphicsPipeline> PipelineCache::getOrCreateBindGraphicsPipeline(uint32_t shaderModeMask, uint32_t geometryAttributesMask, const std::string& vertShaderPath, const std::string& fragShaderPath, vsg::ref_ptr<vsg::PipelineLayout> pipelineLayout)
 {
-    Key key(shaderModeMask, geometryAttributesMask, vertShaderPath, fragShaderPath);
+    Key key(shaderModeMask, geometryAttributesMask, vertShaderPath, fragShaderPath, pipelineLayout.get());
 
     // check to see if pipeline has already been created
     {
@@ -45,7 +53,7 @@ vsg::ref_ptr<vsg::BindGraphicsPipeline> PipelineCache::getOrCreateBindGraphicsPi
     vsg::DescriptorSetLayoutBindings descriptorBindings;
 
     // add material first if any (for now material is hardcoded to binding MATERIAL_BINDING)
-    if (shaderModeMask & MATERIAL) descriptorBindings.push_back({ MATERIAL_BINDING, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }); // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
+    if ((shaderModeMask & MATERIAL) && !(shaderModeMask & MATERIAL_BUFFER)) descriptorBindings.push_back({ MATERIAL_BINDING, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }); // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
 
     // these need to go in incremental order by texture unit value as that how they will have been added to the desctiptor set
     // VkDescriptorSetLayoutBinding { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
@@ -63,6 +71,14 @@ vsg::ref_ptr<vsg::BindGraphicsPipeline> PipelineCache::getOrCreateBindGraphicsPi
         {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // projection and modelview matrices
     };
 
+    if (shaderModeMask & MATERIAL_BUFFER)
+    {
+        // the material buffer layout is the same for every pipeline so its set 0 binding isn't disturbed by binding the per state sets
+        auto materialSetLayout = vsg::DescriptorSetLayout::create(vsg::DescriptorSetLayoutBindings{{MATERIAL_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}});
+        descriptorSetLayouts.insert(descriptorSetLayouts.begin(), materialSetLayout);
+        pushConstantRanges.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, MATERIAL_INDEX_PUSH_CONSTANT_OFFSET, sizeof(uint32_t)});
+    }
+
     uint32_t vertexBindingIndex = 0;
 
     vsg::VertexInputState::Bindings vertexBindingsDescriptions;
@@ -110,7 +126,7 @@ vsg::ref_ptr<vsg::BindGraphicsPipeline> PipelineCache::getOrCreateBindGraphicsPi
         vertexBindingIndex++;
     }
 
-    auto pipelineLayout = vsg::PipelineLayout::create(descriptorSetLayouts, pushConstantRanges);
+    if (!pipelineLayout) pipelineLayout = vsg::PipelineLayout::create(descriptorSetLayouts, pushConstantRanges);
 
     // if blending is requested setup appropriate colorblendstate
     vsg::ColorBlendState::ColorBlendAttachments colorBlendAttachments;
@@ -150,114 +166,473 @@ vsg::ref_ptr<vsg::BindGraphicsPipeline> PipelineCache::getOrCreateBindGraphicsPi
     vsg::ref_ptr<vsg::GraphicsPipeline> graphicsPipeline = vsg::GraphicsPipeline::create(pipelineLayout, shaders, pipelineStates);
     auto bindGraphicsPipeline = vsg::BindGraphicsPipeline::create(graphicsPipeline);
 
-    // assigne the pipeline to cache.
+    // assigne the pipeline to cache, if another thread compiled the same pipeline meanwhile use its one so all users share it
     std::lock_guard<std::mutex> guard(mutex);
-    pipelineMap[key] = bindGraphicsPipeline;
+    return pipelineMap.emplace(key, bindGraphicsPipeline).first->second;
+}
 
-    return bindGraphicsPipeline;
+void PipelineCache::removePipelines(const vsg::PipelineLayout* pipelineLayout)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    for(auto itr = pipelineMap.begin(); itr != pipelineMap.end();)
+    {
+        if (std::get<4>(itr->first)==pipelineLayout) itr = pipelineMap.erase(itr);
+        else ++itr;
+    }
 }
 
 
-osg::ref_ptr<osg::StateSet> SceneBuilderBase::uniqueState(osg::ref_ptr<osg::StateSet> stateset, bool programStateSet)
+namespace
 {
-    if (auto itr = uniqueStateSets.find(stateset); itr != uniqueStateSets.end())
+    struct StateHash
+    {
+        uint64_t value = 0;
+
+        void add(uint64_t v) { value ^= v + 0x9e3779b97f4a7c15ull + (value<<6) + (value>>2); }
+        void add(const void* ptr) { add(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr))); }
+        void add(const std::string& str) { add(static_cast<uint64_t>(std::hash<std::string>()(str))); }
+
+        // hash raw values such as matrices and colours in 8 byte words, zero padding the last
+        void addBytes(const void* data, size_t size)
+        {
+            auto bytes = static_cast<const uint8_t*>(data);
+            for(size_t i=0; i<size; i+=sizeof(uint64_t))
+            {
+                uint64_t word = 0;
+                std::memcpy(&word, bytes+i, std::min(sizeof(uint64_t), size-i));
+                add(word);
+            }
+        }
+    };
+
+    bool isProgram(const osg::StateAttribute* attribute)
     {
-        DEBUG_OUTPUT<<"    uniqueState() found state"<<std::endl;
-        return *itr;
+        return dynamic_cast<const osg::Program*>(attribute)!=nullptr;
     }
 
-    DEBUG_OUTPUT<<"    uniqueState() inserting state"<<std::endl;
+    // programs go to the program state, all other attributes to the data state
+    bool includeAttribute(SceneBuilderBase::StatePart part, const osg::StateAttribute* attribute)
+    {
+        if (part==SceneBuilderBase::WHOLE_STATE) return true;
+        return (part==SceneBuilderBase::PROGRAM_STATE) == isProgram(attribute);
+    }
 
+    const osg::StateSet::ModeList s_emptyModeList;
+    const osg::StateSet::TextureModeList s_emptyTextureModeList;
+    const osg::StateSet::DefineList s_emptyDefineList;
+    const osg::StateSet::TextureAttributeList s_emptyTextureAttributeList;
+    const osg::StateSet::UniformList s_emptyUniformList;
+}
 
-    if (writeToFileProgramAndDataSetSets && stateset.valid())
+uint64_t SceneBuilderBase::computeStateHash(const osg::StateSet& stateset, StatePart part)
+{
+    bool programLists = (part!=DATA_STATE);
+    bool dataLists = (part!=PROGRAM_STATE);
+
+    // excluded lists are hashed as empty, as they are in the StateSet created for the part
+    const auto& modes = programLists ? stateset.getModeList() : s_emptyModeList;
+    const auto& textureModes = programLists ? stateset.getTextureModeList() : s_emptyTextureModeList;
+    const auto& defines = programLists ? stateset.getDefineList() : s_emptyDefineList;
+    const auto& textureAttributes = dataLists ? stateset.getTextureAttributeList() : s_emptyTextureAttributeList;
+    const auto& uniforms = dataLists ? stateset.getUniformList() : s_emptyUniformList;
+
+    StateHash hash;
+
+    hash.add(modes.size());
+    for(auto& [mode, value] : modes) { hash.add(mode); hash.add(value); }
+
+    hash.add(textureModes.size());
+    for(auto& unitModes : textureModes)
     {
-        if (programStateSet) osgDB::writeObjectFile(*(stateset), vsg::make_string("programState_", stateMap.size(),".osgt"));
-        else osgDB::writeObjectFile(*(stateset), vsg::make_string("dataState_", stateMap.size(),".osgt"));
+        hash.add(unitModes.size());
+        for(auto& [mode, value] : unitModes) { hash.add(mode); hash.add(value); }
     }
 
-    uniqueStateSets.insert(stateset);
-    return stateset;
+    hash.add(defines.size());
+    for(auto& [name, define] : defines) { hash.add(name); hash.add(define.first); hash.add(define.second); }
+
+    uint64_t numAttributes = 0;
+    for(auto& [typeMember, attribute] : stateset.getAttributeList())
+    {
+        if (!includeAttribute(part, attribute.first.get())) continue;
+        hash.add(typeMember.first); hash.add(typeMember.second); hash.add(attribute.first.get()); hash.add(attribute.second);
+        ++numAttributes;
+    }
+    hash.add(numAttributes);
+
+    hash.add(textureAttributes.size());
+    for(auto& unitAttributes : textureAttributes)
+    {
+        hash.add(unitAttributes.size());
+        for(auto& [typeMember, attribute] : unitAttributes)
+        {
+            hash.add(typeMember.first); hash.add(typeMember.second); hash.add(attribute.first.get()); hash.add(attribute.second);
+        }
+    }
+
+    hash.add(uniforms.size());
+    for(auto& [name, uniform] : uniforms) { hash.add(name); hash.add(uniform.first.get()); hash.add(uniform.second); }
+
+    return hash.value;
 }
 
-SceneBuilderBase::StatePair SceneBuilderBase::computeStatePair(osg::StateSet* stateset)
+bool SceneBuilderBase::equalStatePart(const osg::StateSet& stateset, StatePart part, const osg::StateSet& unique)
 {
-    if (!stateset) return StatePair();
+    bool programLists = (part!=DATA_STATE);
+    bool dataLists = (part!=PROGRAM_STATE);
+
+    if (unique.getModeList() != (programLists ? stateset.getModeList() : s_emptyModeList)) return false;
+    if (unique.getTextureModeList() != (programLists ? stateset.getTextureModeList() : s_emptyTextureModeList)) return false;
+    if (unique.getDefineList() != (programLists ? stateset.getDefineList() : s_emptyDefineList)) return false;
+    if (unique.getTextureAttributeList() != (dataLists ? stateset.getTextureAttributeList() : s_emptyTextureAttributeList)) return false;
+    if (unique.getUniformList() != (dataLists ? stateset.getUniformList() : s_emptyUniformList)) return false;
+
+    // walk the included attributes alongside the unique stateset's, comparing attributes by pointer
+    auto& uniqueAttributes = unique.getAttributeList();
+    auto uniqueItr = uniqueAttributes.begin();
+    for(auto& entry : stateset.getAttributeList())
+    {
+        if (!includeAttribute(part, entry.second.first.get())) continue;
+        if (uniqueItr==uniqueAttributes.end() || *uniqueItr!=entry) return false;
+        ++uniqueItr;
+    }
+    return uniqueItr==uniqueAttributes.end();
+}
+
+osg::ref_ptr<osg::StateSet> SceneBuilderBase::createStatePart(const osg::StateSet& stateset, StatePart part)
+{
+    osg::ref_ptr<osg::StateSet> state = new osg::StateSet;
+
+    if (part!=DATA_STATE)
+    {
+        state->setModeList(stateset.getModeList());
+        state->setTextureModeList(stateset.getTextureModeList());
+        state->setDefineList(stateset.getDefineList());
+    }
 
-    osg::ref_ptr<osg::StateSet> programState = new osg::StateSet;
-    osg::ref_ptr<osg::StateSet> dataState = new osg::StateSet;
+    if (part!=PROGRAM_STATE)
+    {
+        state->setTextureAttributeList(stateset.getTextureAttributeList());
+        state->setUniformList(stateset.getUniformList());
+    }
 
-    programState->setModeList(stateset->getModeList());
-    programState->setTextureModeList(stateset->getTextureModeList());
-    programState->setDefineList(stateset->getDefineList());
+    for(auto& [typeMember, attribute] : stateset.getAttributeList())
+    {
+        if (includeAttribute(part, attribute.first.get())) state->setAttribute(attribute.first.get(), attribute.second);
+    }
 
-    dataState->setAttributeList(stateset->getAttributeList());
-    dataState->setTextureAttributeList(stateset->getTextureAttributeList());
-    dataState->setUniformList(stateset->getUniformList());
+    return state;
+}
 
-    for(auto attribute : stateset->getAttributeList())
+osg::ref_ptr<osg::StateSet> SceneBuilderBase::uniqueState(osg::ref_ptr<osg::StateSet> stateset, bool programStateSet)
+{
+    auto& bucket = uniqueStateTable[computeStateHash(*stateset)];
+    for(auto& unique : bucket)
     {
-        osg::Program* program = dynamic_cast<osg::Program*>(attribute.second.first.get());
-        if (program)
+        if (equalStatePart(*stateset, WHOLE_STATE, *unique))
         {
-            DEBUG_OUTPUT<<"Found program removing from dataState"<<program<<" inserting into programState"<<std::endl;
-            dataState->removeAttribute(program);
-            programState->setAttribute(program, attribute.second.second);
+            DEBUG_OUTPUT<<"    uniqueState() found state"<<std::endl;
+            return unique;
         }
     }
 
-    return StatePair(uniqueState(programState, true), uniqueState(dataState, false));
+    DEBUG_OUTPUT<<"    uniqueState() inserting state"<<std::endl;
+
+    if (writeToFileProgramAndDataSetSets && stateset.valid())
+    {
+        if (programStateSet) osgDB::writeObjectFile(*(stateset), vsg::make_string("programState_", stateNodes.size(),".osgt"));
+        else osgDB::writeObjectFile(*(stateset), vsg::make_string("dataState_", stateNodes.size(),".osgt"));
+    }
+
+    bucket.push_back(stateset);
+    return stateset;
+}
+
+osg::ref_ptr<osg::StateSet> SceneBuilderBase::getOrCreateUniqueStatePart(const osg::StateSet& stateset, StatePart part)
+{
+    auto& bucket = uniqueStateTable[computeStateHash(stateset, part)];
+    for(auto& unique : bucket)
+    {
+        if (equalStatePart(stateset, part, *unique)) return unique;
+    }
+
+    auto state = createStatePart(stateset, part);
+
+    if (writeToFileProgramAndDataSetSets)
+    {
+        if (part==PROGRAM_STATE) osgDB::writeObjectFile(*state, vsg::make_string("programState_", stateNodes.size(),".osgt"));
+        else osgDB::writeObjectFile(*state, vsg::make_string("dataState_", stateNodes.size(),".osgt"));
+    }
+
+    bucket.push_back(state);
+    return state;
+}
+
+SceneBuilderBase::StatePair SceneBuilderBase::computeStatePair(osg::StateSet* stateset)
+{
+    if (!stateset) return StatePair();
+
+    // look the parts up before creating StateSets for them, most stacks resolve to states that already exist
+    return StatePair(getOrCreateUniqueStatePart(*stateset, PROGRAM_STATE), getOrCreateUniqueStatePart(*stateset, DATA_STATE));
 }
 
 SceneBuilderBase::StatePair& SceneBuilderBase::getStatePair()
 {
-    auto& statepair = stateMap[statestack];
+    // the root node is the empty stack, which keeps its null StatePair
+    StateNode* node = currentStateNode;
+    if (node->parent && !node->statePair.first)
+    {
+        node->statePair = computeStatePair(getCombinedStateSet(node));
+    }
+    return node->statePair;
+}
 
-    if (!statestack.empty() && (!statepair.first || !statepair.second))
+osg::StateSet* SceneBuilderBase::getCombinedStateSet(StateNode* node)
+{
+    if (!node->combined)
     {
-        osg::ref_ptr<osg::StateSet> combined;
-        if (statestack.size()==1)
+        if (node->parent==&rootStateNode)
         {
-            combined = statestack.back();
+            node->combined = node->stateset;
         }
         else
         {
-            combined = new osg::StateSet;
-            for(auto& stateset : statestack)
-            {
-                combined->merge(*stateset);
-            }
+            // merge onto a copy of the parent's combined state, so each level only merges its own stateset
+            node->combined = new osg::StateSet(*getCombinedStateSet(node->parent), osg::CopyOp::SHALLOW_COPY);
+            node->combined->merge(*node->stateset);
         }
+    }
+    return node->combined.get();
+}
 
-        statepair = computeStatePair(combined);
+void SceneBuilderBase::pushStateSet(osg::StateSet& stateset)
+{
+    statestack.push_back(&stateset);
 
+    auto& child = currentStateNode->children[&stateset];
+    if (!child)
+    {
+        stateNodes.emplace_back(new StateNode);
+        child = stateNodes.back().get();
+        child->parent = currentStateNode;
+        child->stateset = &stateset;
     }
-    return statepair;
+    currentStateNode = child;
+}
+
+void SceneBuilderBase::popStateSet()
+{
+    statestack.pop_back();
+
+    // only nodes with children need to keep their combined state, leaves such as geometry statesets release it
+    if (currentStateNode->children.empty()) currentStateNode->combined = nullptr;
+    currentStateNode = currentStateNode->parent;
 }
 
-vsg::ref_ptr<vsg::DescriptorImage> SceneBuilderBase::convertToVsgTexture(const osg::Texture* osgtexture)
+WorkerPool* SceneBuilderBase::getOrCreateWorkerPool()
 {
-    if (auto itr = texturesMap.find(osgtexture); itr != texturesMap.end()) return itr->second;
+    if (buildOptions->workerPool) return buildOptions->workerPool.get();
 
+    if (buildOptions->numThreads<=1) return nullptr;
+
+    // the calling thread takes part in the work so only numThreads-1 additional threads are required
+    if (!workerPool) workerPool = WorkerPool::create(buildOptions->numThreads-1);
+
+    return workerPool.get();
+}
+
+vsg::ref_ptr<vsg::DescriptorImage> SceneBuilderBase::createVsgTexture(const osg::Texture* osgtexture, uint32_t unit, bool releaseImage) const
+{
     const osg::Image* image = osgtexture ? osgtexture->getImage(0) : nullptr;
-    auto textureData = convertToVsg(image);
+
+    ImageOptions imageOptions;
+    auto minFilter = osgtexture ? osgtexture->getFilter(osg::Texture::MIN_FILTER) : osg::Texture::LINEAR;
+    if (minFilter!=osg::Texture::NEAREST && minFilter!=osg::Texture::LINEAR)
+    {
+        imageOptions.mipmapFilter = buildOptions->mipmapFilter;
+
+        // the VSG can't generate mipmaps for compressed formats so they have to be created before compression
+        if (imageOptions.mipmapFilter==MIPMAP_FILTER_NONE && buildOptions->textureCompression!=TEXTURE_COMPRESSION_NONE)
+        {
+            imageOptions.mipmapFilter = MIPMAP_FILTER_BOX;
+        }
+    }
+    // only diffuse and ambient textures are sRGB encoded, normal, opacity and specular maps hold linear data
+    imageOptions.sRGB = (unit==DIFFUSE_TEXTURE_UNIT || unit==AMBIENT_TEXTURE_UNIT) && buildOptions->sRGBDiffuseTextures;
+
+    imageOptions.compression = buildOptions->textureCompression;
+
+    if (auto itr = textureMaxDimensions.find(osgtexture); itr != textureMaxDimensions.end()) imageOptions.maxDimension = itr->second;
+    else imageOptions.maxDimension = buildOptions->maxTextureDimension;
+    if (unit==NORMAL_TEXTURE_UNIT) imageOptions.role = TEXTURE_ROLE_NORMAL;
+    else if (unit!=DIFFUSE_TEXTURE_UNIT) imageOptions.role = TEXTURE_ROLE_OPACITY;
+
+    buildOptions->formatProfile.apply(imageOptions);
+    imageOptions.dropOpaqueAlpha = buildOptions->analyseOpacity && (unit==DIFFUSE_TEXTURE_UNIT);
+    imageOptions.releaseSource = releaseImage;
+
+    if (buildOptions->textureRegistry)
+    {
+        return buildOptions->textureRegistry->getOrCreateDescriptorImage(osgtexture, unit, imageOptions);
+    }
+
+    // the sampler's maxLod is computed from the image, so create it before the image's data may be released
+    vsg::ref_ptr<vsg::Sampler> sampler = buildOptions->samplerCache->getOrCreateSampler(osgtexture, imageOptions.maxDimension);
+
+    auto textureData = convertToVsg(image, imageOptions);
     if (!textureData)
     {
         // DEBUG_OUTPUT << "Could not convert osg image data" << std::endl;
         return vsg::ref_ptr<vsg::DescriptorImage>();
     }
 
-    vsg::ref_ptr<vsg::Sampler> sampler = convertToSampler(osgtexture);
+    // shaders are looking for textures in original units
+    return vsg::DescriptorImage::create(sampler, textureData, unit, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+}
+
+vsg::ref_ptr<vsg::DescriptorImage> SceneBuilderBase::convertToVsgTexture(const osg::Texture* osgtexture, uint32_t unit)
+{
+    TextureUnitPair key(osgtexture, unit);
+    {
+        std::lock_guard<std::mutex> guard(texturesMutex);
+        if (auto itr = texturesMap.find(key); itr != texturesMap.end()) return itr->second;
+    }
+
+    auto texture = createVsgTexture(osgtexture, unit);
+    if (!texture) return texture;
+
+    // keep the first conversion if another thread converted the same texture meanwhile
+    std::lock_guard<std::mutex> guard(texturesMutex);
+    return texturesMap.emplace(key, texture).first->second;
+}
+
+uint64_t SceneBuilderBase::computeTextureSignature(const osg::Texture* osgtexture, uint32_t unit) const
+{
+    const osg::Image* image = osgtexture ? osgtexture->getImage(0) : nullptr;
+
+    StateHash hash;
+    hash.add(osgtexture);
+    hash.add(unit);
+    hash.add(image);
+    if (image) hash.add(image->getModifiedCount());
+
+    uint32_t maxDimension = buildOptions->maxTextureDimension;
+    if (auto itr = textureMaxDimensions.find(osgtexture); itr != textureMaxDimensions.end()) maxDimension = itr->second;
+    hash.add(maxDimension);
+
+    // the sampler cache shares samplers by value, so the same sampler means the same filters, wrap modes, anisotropy and LOD range
+    hash.add(buildOptions->samplerCache->getOrCreateSampler(osgtexture, maxDimension).get());
+
+    return hash.value;
+}
+
+void SceneBuilderBase::convertTextures()
+{
+    std::vector<osg::ref_ptr<osg::StateSet>> dataStates;
+    for(auto& stateNode : stateNodes)
+    {
+        if (stateNode->statePair.second) dataStates.push_back(stateNode->statePair.second);
+    }
+
+    convertTextures(dataStates);
+}
+
+void SceneBuilderBase::convertTextures(const std::vector<osg::ref_ptr<osg::StateSet>>& statesets)
+{
+    static const std::pair<uint32_t, uint32_t> s_textureModeUnits[] = {
+        {DIFFUSE_MAP, DIFFUSE_TEXTURE_UNIT},
+        {OPACITY_MAP, OPACITY_TEXTURE_UNIT},
+        {AMBIENT_MAP, AMBIENT_TEXTURE_UNIT},
+        {NORMAL_MAP, NORMAL_TEXTURE_UNIT},
+        {SPECULAR_MAP, SPECULAR_TEXTURE_UNIT}
+    };
+
+    // collect the unique textures, in the order they are first referenced so results are consistent between runs
+    std::vector<TextureUnitPair> textures;
+    std::set<TextureUnitPair> visited;
+    for(auto& stateset : statesets)
+    {
+        if (!stateset) continue;
+
+        uint32_t shaderModeMask = (calculateShaderModeMask(stateset) | buildOptions->overrideShaderModeMask) & buildOptions->supportedShaderModeMask;
+        for(auto& [mode, unit] : s_textureModeUnits)
+        {
+            if ((shaderModeMask & mode)==0) continue;
+
+            auto texture = dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+            TextureUnitPair key(texture, unit);
+            if (!texture || texturesMap.count(key)>0 || !visited.insert(key).second) continue;
+
+            // textures converted by the previous createVSG() are reused while their image and sampler are unchanged
+            auto itr = convertedTextures.find(key);
+            if (itr != convertedTextures.end() && !isDirty(texture) && !isDirty(texture->getImage(0)) && itr->second.signature==computeTextureSignature(texture, unit))
+            {
+                texturesMap[key] = itr->second.descriptorImage;
+                ++reconversionStats.numReusedTextures;
+            }
+            else
+            {
+                textures.push_back(key);
+            }
+        }
+    }
+
+    DEBUG_OUTPUT<<"convertTextures() converting "<<textures.size()<<" textures"<<std::endl;
+
+    // other images are still read by the osg scene, or by another texture or unit, so are copied
+    std::vector<bool> releaseImages(textures.size(), false);
+    if (buildOptions->releaseSourceImages)
+    {
+        std::map<const osg::Image*, uint32_t> imageUses;
+        for(auto& key : textures) ++imageUses[key.first->getImage(0)];
+
+        for(size_t i=0; i<textures.size(); ++i)
+        {
+            const osg::Image* image = textures[i].first->getImage(0);
+            releaseImages[i] = image && imageUses[image]==1 && image->referenceCount()==1;
+
+            // classifyOpacity() reads the alpha statistics of diffuse and opacity maps, so compute them while the image still has its data
+            if (releaseImages[i] && buildOptions->analyseOpacity)
+            {
+                if (textures[i].second==DIFFUSE_TEXTURE_UNIT) getAlphaStatistics(image, TEXTURE_ROLE_COLOR);
+                else if (textures[i].second==OPACITY_TEXTURE_UNIT) getAlphaStatistics(image, TEXTURE_ROLE_OPACITY);
+            }
+        }
+    }
+
+    // signatures read the images, so are computed before their data may be released
+    std::vector<uint64_t> signatures(textures.size());
+    for(size_t i=0; i<textures.size(); ++i) signatures[i] = computeTextureSignature(textures[i].first, textures[i].second);
+
+    // textures not yet started when the conversion is cancelled are left unconverted
+    std::vector<vsg::ref_ptr<vsg::DescriptorImage>> converted(textures.size());
+    auto convert = [&](size_t i) { if (!cancelled()) converted[i] = createVsgTexture(textures[i].first, textures[i].second, releaseImages[i]); };
+    if (auto pool = getOrCreateWorkerPool(); pool && textures.size()>1)
+    {
+        pool->run(textures.size(), convert);
+    }
+    else
+    {
+        for(size_t i=0; i<textures.size(); ++i) convert(i);
+    }
 
-    auto texture = vsg::DescriptorImage::create(sampler, textureData, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-    texturesMap[osgtexture] = texture;
+    for(size_t i=0; i<textures.size(); ++i)
+    {
+        if (!converted[i]) continue;
 
-    return texture;
+        texturesMap[textures[i]] = converted[i];
+        convertedTextures[textures[i]] = ConvertedTexture{textures[i].first, signatures[i], converted[i]};
+        ++reconversionStats.numConvertedTextures;
+    }
 }
 
 vsg::ref_ptr<vsg::DescriptorSet> SceneBuilderBase::createVsgStateSet(vsg::ref_ptr<vsg::DescriptorSetLayout> descriptorSetLayout, const osg::StateSet* stateset, uint32_t shaderModeMask)
 {
     if (!stateset) return vsg::ref_ptr<vsg::DescriptorSet>();
 
+    // bindless states read their material and textures from the scene wide set
+    if (shaderModeMask & ShaderModeMask::BINDLESS_TEXTURES) return vsg::ref_ptr<vsg::DescriptorSet>();
+
     vsg::Descriptors descriptors;
 
     auto addTexture = [&] (unsigned int i)
@@ -266,11 +641,9 @@ vsg::ref_ptr<vsg::DescriptorSet> SceneBuilderBase::createVsgStateSet(vsg::ref_pt
         const osg::Texture* osgtex = dynamic_cast<const osg::Texture*>(texatt);
         if (osgtex)
         {
-            auto vsgtex = convertToVsgTexture(osgtex);
+            auto vsgtex = convertToVsgTexture(osgtex, i);
             if (vsgtex)
             {
-                // shaders are looking for textures in original units
-                vsgtex->dstBinding = i;
                 descriptors.push_back(vsgtex);
             }
             else
@@ -282,7 +655,7 @@ vsg::ref_ptr<vsg::DescriptorSet> SceneBuilderBase::createVsgStateSet(vsg::ref_pt
 
     // add material first
     const osg::Material* osg_material = dynamic_cast<const osg::Material*>(stateset->getAttribute(osg::StateAttribute::Type::MATERIAL));
-    if ((shaderModeMask & ShaderModeMask::MATERIAL) && (osg_material != nullptr) /*&& stateset->getMode(GL_COLOR_MATERIAL) == osg::StateAttribute::Values::ON*/)
+    if ((shaderModeMask & ShaderModeMask::MATERIAL) && !(shaderModeMask & ShaderModeMask::MATERIAL_BUFFER) && (osg_material != nullptr) /*&& stateset->getMode(GL_COLOR_MATERIAL) == osg::StateAttribute::Values::ON*/)
     {
         auto matdata = convertToMaterialValue(osg_material);
         auto vsg_materialUniform = vsg::DescriptorBuffer::create(matdata, MATERIAL_BINDING); // just use high value for now, should maybe put uniforms into a different descriptor set to simplify binding indexes
@@ -304,6 +677,130 @@ vsg::ref_ptr<vsg::DescriptorSet> SceneBuilderBase::createVsgStateSet(vsg::ref_pt
 }
 
 
+namespace
+{
+    // opacity values are multiplied together in the fragment shader, a product of binary values is still binary
+    void multiply(AlphaStatistics& lhs, const AlphaStatistics& rhs)
+    {
+        lhs.minAlpha *= rhs.minAlpha;
+        lhs.maxAlpha *= rhs.maxAlpha;
+        lhs.binary = lhs.binary && rhs.binary;
+    }
+
+    AlphaStatistics constantAlpha(float alpha)
+    {
+        return AlphaStatistics{alpha, alpha, alpha==0.0f || alpha>=1.0f};
+    }
+
+    template<typename T>
+    AlphaStatistics computeColorAlphaStatistics(const T* colors, float scale)
+    {
+        AlphaStatistics stats{1.0f, 0.0f, true};
+        for(auto& color : *colors)
+        {
+            float alpha = static_cast<float>(color.a())*scale;
+            stats.minAlpha = std::min(stats.minAlpha, alpha);
+            stats.maxAlpha = std::max(stats.maxAlpha, alpha);
+            if (alpha!=0.0f && alpha<1.0f) stats.binary = false;
+        }
+        return stats;
+    }
+}
+
+AlphaStatistics SceneBuilderBase::getAlphaStatistics(const osg::Image* image, TextureRole role)
+{
+    if (alphaStatisticsOwner) return alphaStatisticsOwner->getAlphaStatistics(image, role);
+
+    auto key = std::make_pair(image, role);
+    unsigned int modifiedCount = image ? image->getModifiedCount() : 0;
+    {
+        std::lock_guard<std::mutex> guard(alphaStatisticsMutex);
+        if (auto itr = alphaStatisticsMap.find(key); itr != alphaStatisticsMap.end() && itr->second.modifiedCount==modifiedCount) return itr->second.statistics;
+    }
+
+    // scan outside the lock so subgraphs can scan different images at the same time
+    auto statistics = computeAlphaStatistics(image, role);
+
+    std::lock_guard<std::mutex> guard(alphaStatisticsMutex);
+    alphaStatisticsMap[key] = ImageAlphaStatistics{image, modifiedCount, statistics};
+    return statistics;
+}
+
+AlphaStatistics SceneBuilderBase::getAlphaStatistics(const osg::Array* colors)
+{
+    if (alphaStatisticsOwner) return alphaStatisticsOwner->getAlphaStatistics(colors);
+
+    if (!colors) return AlphaStatistics();
+
+    unsigned int modifiedCount = colors->getModifiedCount();
+    {
+        std::lock_guard<std::mutex> guard(alphaStatisticsMutex);
+        if (auto itr = colorAlphaStatisticsMap.find(colors); itr != colorAlphaStatisticsMap.end() && itr->second.modifiedCount==modifiedCount) return itr->second.statistics;
+    }
+
+    // colour arrays of other types are treated as opaque
+    AlphaStatistics statistics;
+    if (auto vec4Colors = dynamic_cast<const osg::Vec4Array*>(colors)) statistics = computeColorAlphaStatistics(vec4Colors, 1.0f);
+    else if (auto vec4ubColors = dynamic_cast<const osg::Vec4ubArray*>(colors)) statistics = computeColorAlphaStatistics(vec4ubColors, 1.0f/255.0f);
+    else if (auto vec4dColors = dynamic_cast<const osg::Vec4dArray*>(colors)) statistics = computeColorAlphaStatistics(vec4dColors, 1.0f);
+
+    std::lock_guard<std::mutex> guard(alphaStatisticsMutex);
+    colorAlphaStatisticsMap[colors] = ArrayAlphaStatistics{colors, modifiedCount, statistics};
+    return statistics;
+}
+
+uint32_t SceneBuilderBase::classifyOpacity(const osg::StateSet* stateset, const osg::Geometry* geometry, uint32_t shaderModeMask)
+{
+    if ((shaderModeMask & BLEND)==0 || !buildOptions->analyseOpacity) return shaderModeMask;
+
+    AlphaStatistics stats;
+
+    if (stateset)
+    {
+        auto addTexture = [&](uint32_t mode, uint32_t unit, TextureRole role)
+        {
+            if ((shaderModeMask & mode)==0 || (buildOptions->supportedShaderModeMask & mode)==0) return;
+
+            auto texture = dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+            if (texture) multiply(stats, getAlphaStatistics(texture->getImage(0), role));
+        };
+
+        addTexture(DIFFUSE_MAP, DIFFUSE_TEXTURE_UNIT, TEXTURE_ROLE_COLOR);
+        addTexture(OPACITY_MAP, OPACITY_TEXTURE_UNIT, TEXTURE_ROLE_OPACITY);
+
+        if (auto material = dynamic_cast<const osg::Material*>(stateset->getAttribute(osg::StateAttribute::MATERIAL)))
+        {
+            multiply(stats, constantAlpha(material->getDiffuse(osg::Material::FRONT).a()));
+        }
+    }
+
+    if (geometry) multiply(stats, getAlphaStatistics(geometry->getColorArray()));
+
+    if (stats.opaque())
+    {
+        DEBUG_OUTPUT<<"classifyOpacity() alpha is always 1.0, drawing as opaque"<<std::endl;
+        return shaderModeMask & ~BLEND;
+    }
+
+    if (stats.binary)
+    {
+        DEBUG_OUTPUT<<"classifyOpacity() alpha is binary, drawing as alpha tested"<<std::endl;
+        return (shaderModeMask & ~BLEND) | ALPHA_TEST;
+    }
+
+    return shaderModeMask;
+}
+
+uint32_t SceneBuilderBase::classifyNormalMap(const osg::StateSet* stateset, uint32_t shaderModeMask) const
+{
+    if ((shaderModeMask & NORMAL_MAP)==0 || !stateset) return shaderModeMask;
+
+    auto texture = dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(NORMAL_TEXTURE_UNIT, osg::StateAttribute::TEXTURE));
+    if (texture && normalMapKeepsOnlyXY(texture->getImage(0), buildOptions->textureCompression)) shaderModeMask |= NORMAL_MAP_XY;
+
+    return shaderModeMask;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 //
 //   SceneBuilder
@@ -476,78 +973,468 @@ void SceneBuilder::apply(osg::Geometry& geometry)
 
     StatePair& statePair = getStatePair();
 
-    osg::Matrix matrix;
-    if (!matrixstack.empty()) matrix = matrixstack.back();
-
-    // Build programTransformStateMap
-    {
-        TransformStatePair& transformStatePair = programTransformStateMap[statePair.first];
-        StateGeometryMap& stateGeometryMap = transformStatePair.matrixStateGeometryMap[matrix];
-        stateGeometryMap[statePair.second].push_back(&geometry);
-
-        TransformGeometryMap& transformGeometryMap = transformStatePair.stateTransformMap[statePair.second];
-        transformGeometryMap[matrix].push_back(&geometry);
-    }
-
-    // Build new masksTransformStateMap
-    {
-        Masks masks(calculateShaderModeMask(statePair.first.get()) | calculateShaderModeMask(statePair.second.get()) | nodeShaderModeMasks, calculateAttributesMask(&geometry));
-
-        DEBUG_OUTPUT<<"populating masks ("<<masks.first<<", "<<masks.second<<")"<<std::endl;
+    uint32_t shaderModeMask = calculateShaderModeMask(statePair.first.get()) | calculateShaderModeMask(statePair.second.get()) | nodeShaderModeMasks;
+    shaderModeMask = classifyNormalMap(statePair.second.get(), shaderModeMask);
+    Masks masks(classifyOpacity(statePair.second.get(), &geometry, shaderModeMask), calculateAttributesMask(&geometry));
 
-        TransformStatePair& transformStatePair = masksTransformStateMap[masks];
-        StateGeometryMap& stateGeometryMap = transformStatePair.matrixStateGeometryMap[matrix];
-        stateGeometryMap[statePair.second].push_back(&geometry);
+    DEBUG_OUTPUT<<"populating masks ("<<masks.first<<", "<<masks.second<<")"<<std::endl;
 
-        TransformGeometryMap& transformGeometryMap = transformStatePair.stateTransformMap[statePair.second];
-        transformGeometryMap[matrix].push_back(&geometry);
-    }
+    // just record the geometry, grouping by program, masks, state and matrix is done in one pass by groupGeometries()
+    GeometryRecord record;
+    record.geometry = &geometry;
+    record.programStateId = internState(statePair.first.get());
+    record.dataStateId = internState(statePair.second.get());
+    record.matrixId = matrixIdStack.empty() ? internMatrix(osg::Matrix()) : matrixIdStack.back();
+    record.masks = masks;
+    geometryRecords.push_back(record);
 
     DEBUG_OUTPUT<<"   Geometry "<<geometry.className()<<" ss="<<statestack.size()<<" ms="<<matrixstack.size()<<std::endl;
 
     if (geometry.getStateSet()) popStateSet();
 }
 
-void SceneBuilder::pushStateSet(osg::StateSet& stateset)
-{
-    statestack.push_back(&stateset);
-}
-
-void SceneBuilder::popStateSet()
-{
-    statestack.pop_back();
-}
-
 void SceneBuilder::SceneBuilder::pushMatrix(const osg::Matrix& matrix)
 {
     matrixstack.push_back(matrix);
+    matrixIdStack.push_back(internMatrix(matrix));
 }
 
 void SceneBuilder::popMatrix()
 {
     matrixstack.pop_back();
+    matrixIdStack.pop_back();
 }
 
-void SceneBuilder::print()
+size_t SceneBuilder::MatrixHash::operator() (const osg::Matrix& matrix) const
 {
-    DEBUG_OUTPUT<<"\nprint()\n";
-    DEBUG_OUTPUT<<"   programTransformStateMap.size() = "<<programTransformStateMap.size()<<std::endl;
-    for(auto [programStateSet, transformStatePair] : programTransformStateMap)
+    size_t seed = 0;
+    const osg::Matrix::value_type* ptr = matrix.ptr();
+    for(int i=0; i<16; ++i)
     {
-        DEBUG_OUTPUT<<"       programStateSet = "<<programStateSet.get()<<std::endl;
-        DEBUG_OUTPUT<<"           transformStatePair.matrixStateGeometryMap.size() = "<<transformStatePair.matrixStateGeometryMap.size()<<std::endl;
-        DEBUG_OUTPUT<<"           transformStatePair.stateTransformMap.size() = "<<transformStatePair.stateTransformMap.size()<<std::endl;
+        // fold -0.0 into 0.0 so the hash agrees with osg::Matrix::operator==
+        osg::Matrix::value_type value = (ptr[i]==0.0) ? 0.0 : ptr[i];
+        seed ^= std::hash<osg::Matrix::value_type>()(value) + 0x9e3779b97f4a7c15ull + (seed<<6) + (seed>>2);
     }
+    return seed;
 }
 
-osg::ref_ptr<osg::Node> SceneBuilder::createStateGeometryGraphOSG(StateGeometryMap& stateGeometryMap)
+uint32_t SceneBuilder::internMatrix(const osg::Matrix& matrix)
 {
-    DEBUG_OUTPUT<<"createStateGeometryGraph()"<<stateGeometryMap.size()<<std::endl;
+    auto [itr, inserted] = matrixIds.emplace(matrix, static_cast<uint32_t>(matrices.size()));
+    if (inserted) matrices.push_back(matrix);
+    return itr->second;
+}
+
+uint32_t SceneBuilder::internState(osg::StateSet* stateset)
+{
+    // statesets are already unique by value, see getOrCreateUniqueStatePart(), so the pointer identifies them
+    auto [itr, inserted] = stateIds.emplace(stateset, static_cast<uint32_t>(states.size()));
+    if (inserted) states.push_back(stateset);
+    return itr->second;
+}
+
+namespace
+{
+    struct MasksHash
+    {
+        size_t operator() (const SceneBuilder::Masks& masks) const
+        {
+            return std::hash<uint64_t>()((static_cast<uint64_t>(masks.first) << 32) | masks.second);
+        }
+    };
+
+    // fill the stateTransformMap and matrixStateGeometryMap of each group's TransformStatePair from the records assigned to it.
+    // records are sorted on their interned ids so each state, matrix and geometry list is appended to just once.
+    void fillTransformStatePairs(const std::vector<SceneBuilder::GeometryRecord>& records, const std::vector<uint32_t>& groups, const std::vector<SceneBuilder::TransformStatePair*>& transformStatePairs,
+                                 const std::vector<osg::Matrix>& matrices, const std::vector<osg::ref_ptr<osg::StateSet>>& states)
+    {
+        std::vector<uint32_t> order(records.size());
+        std::iota(order.begin(), order.end(), 0);
+
+        // stable sorts so geometries stay in the order they were visited
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs)
+        {
+            return std::tie(groups[lhs], records[lhs].dataStateId, records[lhs].matrixId) < std::tie(groups[rhs], records[rhs].dataStateId, records[rhs].matrixId);
+        });
+
+        for(size_t i=0; i<order.size(); ++i)
+        {
+            auto& record = records[order[i]];
+            auto previous = (i>0) ? order[i-1] : order[i];
+            bool newState = (i==0) || groups[previous]!=groups[order[i]] || records[previous].dataStateId!=record.dataStateId;
+            bool newMatrix = newState || records[previous].matrixId!=record.matrixId;
+
+            auto& stateTransformMap = transformStatePairs[groups[order[i]]]->stateTransformMap;
+            if (newState) stateTransformMap.emplace_back(states[record.dataStateId], SceneBuilder::TransformGeometryMap());
+            if (newMatrix) stateTransformMap.back().second.emplace_back(matrices[record.matrixId], SceneBuilder::Geometries());
+            stateTransformMap.back().second.back().second.push_back(record.geometry);
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs)
+        {
+            return std::tie(groups[lhs], records[lhs].matrixId, records[lhs].dataStateId) < std::tie(groups[rhs], records[rhs].matrixId, records[rhs].dataStateId);
+        });
+
+        for(size_t i=0; i<order.size(); ++i)
+        {
+            auto& record = records[order[i]];
+            auto previous = (i>0) ? order[i-1] : order[i];
+            bool newMatrix = (i==0) || groups[previous]!=groups[order[i]] || records[previous].matrixId!=record.matrixId;
+            bool newState = newMatrix || records[previous].dataStateId!=record.dataStateId;
+
+            auto& matrixStateGeometryMap = transformStatePairs[groups[order[i]]]->matrixStateGeometryMap;
+            if (newMatrix) matrixStateGeometryMap.emplace_back(matrices[record.matrixId], SceneBuilder::StateGeometryMap());
+            if (newState) matrixStateGeometryMap.back().second.emplace_back(states[record.dataStateId], SceneBuilder::Geometries());
+            matrixStateGeometryMap.back().second.back().second.push_back(record.geometry);
+        }
+    }
+}
+
+void SceneBuilder::groupGeometries()
+{
+    programTransformStateMap.clear();
+    masksTransformStateMap.clear();
+
+    // assign each record to its program and masks groups, the groups are in order of first use
+    std::vector<uint32_t> programGroups(geometryRecords.size());
+    std::vector<uint32_t> masksGroups(geometryRecords.size());
+
+    std::unordered_map<uint32_t, uint32_t> programIndices;
+    std::unordered_map<Masks, uint32_t, MasksHash> masksIndices;
+    for(size_t i=0; i<geometryRecords.size(); ++i)
+    {
+        auto& record = geometryRecords[i];
+
+        auto [programItr, newProgram] = programIndices.emplace(record.programStateId, static_cast<uint32_t>(programTransformStateMap.size()));
+        if (newProgram) programTransformStateMap.emplace_back(states[record.programStateId], TransformStatePair());
+        programGroups[i] = programItr->second;
+
+        auto [masksItr, newMasks] = masksIndices.emplace(record.masks, static_cast<uint32_t>(masksTransformStateMap.size()));
+        if (newMasks) masksTransformStateMap.emplace_back(record.masks, TransformStatePair());
+        masksGroups[i] = masksItr->second;
+    }
+
+    // take the addresses once the vectors have stopped growing
+    std::vector<TransformStatePair*> programTransformStatePairs;
+    for(auto& entry : programTransformStateMap) programTransformStatePairs.push_back(&entry.second);
+
+    std::vector<TransformStatePair*> masksTransformStatePairs;
+    for(auto& entry : masksTransformStateMap) masksTransformStatePairs.push_back(&entry.second);
+
+    fillTransformStatePairs(geometryRecords, programGroups, programTransformStatePairs, matrices, states);
+    fillTransformStatePairs(geometryRecords, masksGroups, masksTransformStatePairs, matrices, states);
+}
+
+namespace
+{
+    // subgraph of the scene traversed by its own SceneBuilder, with the state and matrix stacks above it
+    struct SubgraphTask
+    {
+        osg::ref_ptr<osg::Node> node;
+        SceneBuilder::StateStack statestack;
+        SceneBuilder::MatrixStack matrixstack;
+        std::vector<osg::Matrix> precedingMatrices; // pushed above the partition depth since the previous task, interned first so matrix ids follow the serial order
+        bool serial = false; // modifies drawables other subgraphs may share, so is traversed on the calling thread between the others
+    };
+
+    // finds whether a subgraph holds a billboard, as SceneBuilder::apply(osg::Billboard&) may modify the billboard's drawables
+    class FindBillboard : public osg::NodeVisitor
+    {
+    public:
+        FindBillboard(const osg::NodeVisitor& nv):
+            osg::NodeVisitor(nv.getTraversalMode())
+        {
+            setTraversalMask(nv.getTraversalMask());
+            setNodeMaskOverride(nv.getNodeMaskOverride());
+        }
+
+        bool found = false;
+
+        using osg::NodeVisitor::apply;
+
+        void apply(osg::Node& node) override { if (!found) traverse(node); }
+        void apply(osg::Billboard&) override { found = true; }
+    };
+
+    // walk the groups and transforms above the partition depth collecting the subgraphs to traverse, in traversal order.
+    // leaves and billboards above the partition depth become subgraphs of their own.
+    class PartitionVisitor : public osg::NodeVisitor
+    {
+    public:
+        PartitionVisitor(const osg::NodeVisitor& nv, uint32_t depth):
+            osg::NodeVisitor(nv.getTraversalMode()),
+            partitionDepth(depth)
+        {
+            setTraversalMask(nv.getTraversalMask());
+            setNodeMaskOverride(nv.getNodeMaskOverride());
+        }
+
+        uint32_t partitionDepth;
+        uint32_t depth = 0;
+        SceneBuilder::StateStack statestack;
+        SceneBuilder::MatrixStack matrixstack;
+        std::vector<osg::Matrix> pendingMatrices;
+        std::vector<SubgraphTask> tasks;
+
+        using osg::NodeVisitor::apply;
+
+        void addTask(osg::Node* node)
+        {
+            tasks.push_back(SubgraphTask{node, statestack, matrixstack, std::move(pendingMatrices)});
+            pendingMatrices.clear();
+        }
+
+        void apply(osg::Node& node) override { addTask(&node); }
+        void apply(osg::Billboard& billboard) override { addTask(&billboard); }
+
+        void apply(osg::Group& group) override
+        {
+            if (depth>=partitionDepth) { addTask(&group); return; }
+
+            if (group.getStateSet()) statestack.push_back(group.getStateSet());
+
+            ++depth;
+            traverse(group);
+            --depth;
+
+            if (group.getStateSet()) statestack.pop_back();
+        }
+
+        void apply(osg::Transform& transform) override
+        {
+            if (depth>=partitionDepth) { addTask(&transform); return; }
+
+            if (transform.getStateSet()) statestack.push_back(transform.getStateSet());
+
+            osg::Matrix matrix;
+            if (!matrixstack.empty()) matrix = matrixstack.back();
+            transform.computeLocalToWorldMatrix(matrix, this);
+
+            matrixstack.push_back(matrix);
+            pendingMatrices.push_back(matrix);
+
+            ++depth;
+            traverse(transform);
+            --depth;
+
+            matrixstack.pop_back();
+
+            if (transform.getStateSet()) statestack.pop_back();
+        }
+    };
+}
+
+void SceneBuilder::traverseScene(osg::Node& scene)
+{
+    beginPhase("traverse");
+
+    auto pool = (buildOptions->traversalPartitionDepth>0) ? getOrCreateWorkerPool() : nullptr;
+    if (!pool)
+    {
+        scene.accept(*this);
+        endPhase({geometryRecords.size(), 0});
+        return;
+    }
+
+    PartitionVisitor partition(*this, buildOptions->traversalPartitionDepth);
+    scene.accept(partition);
+
+    // matrices pushed after the last subgraph aren't used by any geometry, but intern them anyway so the ids match a serial traversal
+    if (!partition.pendingMatrices.empty()) partition.addTask(nullptr);
+
+    auto& tasks = partition.tasks;
+
+    DEBUG_OUTPUT<<"SceneBuilder::traverseScene() traversing "<<tasks.size()<<" subgraphs"<<std::endl;
+
+    // billboards converted with SHADER_TRANSLATE set a bounding box callback and vertex attribute on their drawables, which
+    // other subgraphs may share. the subgraphs holding them are traversed on this thread, in order between batches of the others,
+    // so the drawables are modified when a serial traversal would modify them
+    if (!buildOptions->billboardTransform)
+    {
+        for(auto& task : tasks)
+        {
+            if (!task.node) continue;
+
+            FindBillboard findBillboard(*this);
+            task.node->accept(findBillboard);
+            task.serial = findBillboard.found;
+        }
+    }
+
+    std::vector<osg::ref_ptr<SceneBuilder>> subgraphBuilders(tasks.size());
+    auto traverseTask = [&](size_t i)
+    {
+        auto& task = tasks[i];
+        if (!task.node) return;
+
+        // each subgraph gets its own state, matrix and grouping containers, so the threads share nothing but the osg scene and the alpha statistics
+        osg::ref_ptr<SceneBuilder> builder = new SceneBuilder(buildOptions);
+        builder->alphaStatisticsOwner = this;
+        builder->setTraversalMode(getTraversalMode());
+        builder->setTraversalMask(getTraversalMask());
+        builder->setNodeMaskOverride(getNodeMaskOverride());
+
+        for(auto& stateset : task.statestack) builder->pushStateSet(*stateset);
+        for(auto& matrix : task.matrixstack) builder->pushMatrix(matrix);
+
+        task.node->accept(*builder);
+
+        subgraphBuilders[i] = builder;
+    };
+
+    for(size_t begin=0; begin<tasks.size();)
+    {
+        if (tasks[begin].serial)
+        {
+            traverseTask(begin++);
+            continue;
+        }
+
+        size_t end = begin;
+        while(end<tasks.size() && !tasks[end].serial) ++end;
+
+        pool->run(end-begin, [&](size_t i) { traverseTask(begin+i); });
+        begin = end;
+    }
+
+    // merge in traversal order, so matrices and states get the ids, and geometries the order, they have when traversed serially
+    for(size_t i=0; i<tasks.size(); ++i)
+    {
+        for(auto& matrix : tasks[i].precedingMatrices) internMatrix(matrix);
+
+        if (subgraphBuilders[i]) mergeSubgraph(*subgraphBuilders[i]);
+        subgraphBuilders[i] = nullptr;
+    }
+
+    endPhase({geometryRecords.size(), 0});
+}
+
+void SceneBuilder::mergeSubgraph(SceneBuilder& subgraphBuilder)
+{
+    // the subgraph's matrices and states are in the order it first used them, which continues the order of this builder's
+    std::vector<uint32_t> matrixIdMap(subgraphBuilder.matrices.size());
+    for(size_t i=0; i<subgraphBuilder.matrices.size(); ++i)
+    {
+        matrixIdMap[i] = internMatrix(subgraphBuilder.matrices[i]);
+    }
+
+    std::vector<bool> programStates(subgraphBuilder.states.size(), false);
+    for(auto& record : subgraphBuilder.geometryRecords) programStates[record.programStateId] = true;
+
+    // statesets that are equal to ones from earlier subgraphs are replaced by those, as a serial traversal would have found them
+    std::vector<uint32_t> stateIdMap(subgraphBuilder.states.size());
+    for(size_t i=0; i<subgraphBuilder.states.size(); ++i)
+    {
+        auto& stateset = subgraphBuilder.states[i];
+        stateIdMap[i] = internState(stateset ? uniqueState(stateset, programStates[i]).get() : nullptr);
+    }
+
+    geometryRecords.reserve(geometryRecords.size() + subgraphBuilder.geometryRecords.size());
+    for(auto& record : subgraphBuilder.geometryRecords)
+    {
+        GeometryRecord merged = record;
+        merged.programStateId = stateIdMap[record.programStateId];
+        merged.dataStateId = stateIdMap[record.dataStateId];
+        merged.matrixId = matrixIdMap[record.matrixId];
+        geometryRecords.push_back(merged);
+    }
+}
+
+void SceneBuilder::resetTraversal()
+{
+    geometryRecords.clear();
+    matrices.clear();
+    matrixIds.clear();
+    states.clear();
+    stateIds.clear();
+    programTransformStateMap.clear();
+    masksTransformStateMap.clear();
+
+    statestack.clear();
+    matrixstack.clear();
+    matrixIdStack.clear();
+
+    // the trie caches combined statesets, which are stale once the scene's statesets have been edited
+    rootStateNode.children.clear();
+    stateNodes.clear();
+    currentStateNode = &rootStateNode;
+
+    phaseTimings.clear();
+}
+
+vsg::ref_ptr<vsg::Node> SceneBuilder::updateVSG(osg::Node& scene, vsg::Paths& searchPaths)
+{
+    resetTraversal();
+
+    // dirty images may have been edited without a change to their modified count, so are scanned again once by the traversal
+    for(auto itr = alphaStatisticsMap.begin(); itr != alphaStatisticsMap.end();)
+    {
+        itr = isDirty(itr->first.first) ? alphaStatisticsMap.erase(itr) : std::next(itr);
+    }
+    for(auto itr = colorAlphaStatisticsMap.begin(); itr != colorAlphaStatisticsMap.end();)
+    {
+        itr = isDirty(itr->first) ? colorAlphaStatisticsMap.erase(itr) : std::next(itr);
+    }
+
+    traverseScene(scene);
+    if (cancelled()) return {};
+
+    // drop the unique states and alpha statistics the scene no longer uses, so a long editing session doesn't accumulate them
+    for(auto itr = uniqueStateTable.begin(); itr != uniqueStateTable.end();)
+    {
+        auto& bucket = itr->second;
+        bucket.erase(std::remove_if(bucket.begin(), bucket.end(), [&](const osg::ref_ptr<osg::StateSet>& stateset) { return stateIds.count(stateset.get())==0; }), bucket.end());
+        itr = bucket.empty() ? uniqueStateTable.erase(itr) : std::next(itr);
+    }
+
+    for(auto itr = alphaStatisticsMap.begin(); itr != alphaStatisticsMap.end();)
+    {
+        bool released = itr->second.image && itr->second.image->referenceCount()==1;
+        itr = released ? alphaStatisticsMap.erase(itr) : std::next(itr);
+    }
+    for(auto itr = colorAlphaStatisticsMap.begin(); itr != colorAlphaStatisticsMap.end();)
+    {
+        bool released = itr->second.array && itr->second.array->referenceCount()==1;
+        itr = released ? colorAlphaStatisticsMap.erase(itr) : std::next(itr);
+    }
+
+    // a cancelled conversion leaves the previous one in updatedRoot, and the dirty objects to be reconverted next time
+    auto converted = createVSG(searchPaths, true);
+    if (cancelled()) return {};
+
+    dirtyObjects.clear();
+
+    vsg::Group::Children children;
+    if (converted) children.push_back(converted);
+
+    if (!updatedRoot) updatedRoot = vsg::Group::create();
+    updatedRoot->setChildren(children);
+
+    return updatedRoot;
+}
+
+void SceneBuilder::print()
+{
+    groupGeometries();
+
+    DEBUG_OUTPUT<<"\nprint()\n";
+    DEBUG_OUTPUT<<"   programTransformStateMap.size() = "<<programTransformStateMap.size()<<std::endl;
+    for(auto& [programStateSet, transformStatePair] : programTransformStateMap)
+    {
+        DEBUG_OUTPUT<<"       programStateSet = "<<programStateSet.get()<<std::endl;
+        DEBUG_OUTPUT<<"           transformStatePair.matrixStateGeometryMap.size() = "<<transformStatePair.matrixStateGeometryMap.size()<<std::endl;
+        DEBUG_OUTPUT<<"           transformStatePair.stateTransformMap.size() = "<<transformStatePair.stateTransformMap.size()<<std::endl;
+    }
+}
+
+osg::ref_ptr<osg::Node> SceneBuilder::createStateGeometryGraphOSG(StateGeometryMap& stateGeometryMap)
+{
+    DEBUG_OUTPUT<<"createStateGeometryGraph()"<<stateGeometryMap.size()<<std::endl;
 
     if (stateGeometryMap.empty()) return nullptr;
 
     osg::ref_ptr<osg::Group> group = new osg::Group;
-    for(auto [stateset, geometries] : stateGeometryMap)
+    for(auto& [stateset, geometries] : stateGeometryMap)
     {
         osg::ref_ptr<osg::Group> stateGroup = new osg::Group;
         stateGroup->setStateSet(stateset);
@@ -573,7 +1460,7 @@ osg::ref_ptr<osg::Node> SceneBuilder::createTransformGeometryGraphOSG(TransformG
     if (transformGeometryMap.empty()) return nullptr;
 
     osg::ref_ptr<osg::Group> group = new osg::Group;
-    for(auto [matrix, geometries] : transformGeometryMap)
+    for(auto& [matrix, geometries] : transformGeometryMap)
     {
         osg::ref_ptr<osg::MatrixTransform> transform = new osg::MatrixTransform;
         transform->setMatrix(matrix);
@@ -598,9 +1485,11 @@ osg::ref_ptr<osg::Node> SceneBuilder::createOSG()
     geometriesMap.clear();
     texturesMap.clear();
 
+    groupGeometries();
+
     osg::ref_ptr<osg::Group> group = new osg::Group;
 
-    for(auto [programStateSet, transformStatePair] : programTransformStateMap)
+    for(auto& [programStateSet, transformStatePair] : programTransformStateMap)
     {
         osg::ref_ptr<osg::Group> programGroup = new osg::Group;
         group->addChild(programGroup);
@@ -609,7 +1498,7 @@ osg::ref_ptr<osg::Node> SceneBuilder::createOSG()
         bool transformAtTop = transformStatePair.matrixStateGeometryMap.size() < transformStatePair.stateTransformMap.size();
         if (transformAtTop)
         {
-            for(auto [matrix, stateGeometryMap] : transformStatePair.matrixStateGeometryMap)
+            for(auto& [matrix, stateGeometryMap] : transformStatePair.matrixStateGeometryMap)
             {
                 osg::ref_ptr<osg::Node> stateGeometryGraph = createStateGeometryGraphOSG(stateGeometryMap);
                 if (!stateGeometryGraph) continue;
@@ -629,7 +1518,7 @@ osg::ref_ptr<osg::Node> SceneBuilder::createOSG()
         }
         else
         {
-            for(auto [stateset, transformeGeometryMap] : transformStatePair.stateTransformMap)
+            for(auto& [stateset, transformeGeometryMap] : transformStatePair.stateTransformMap)
             {
                 osg::ref_ptr<osg::Node> transformGeometryGraph = createTransformGeometryGraphOSG(transformeGeometryMap);
                 if (!transformGeometryGraph) continue;
@@ -646,14 +1535,202 @@ osg::ref_ptr<osg::Node> SceneBuilder::createOSG()
     return group;
 }
 
-vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformGeometryMap& transformGeometryMap, vsg::Paths& /*searchPaths*/, uint32_t requiredGeomAttributesMask)
+namespace
+{
+    // bound the sphere after transforming it by the matrix, the radius is scaled by the largest stretch the matrix can apply
+    vsg::sphere transformSphere(const vsg::sphere& bound, const osg::Matrix& matrix)
+    {
+        osg::Vec3d rows[3] = {
+            osg::Vec3d(matrix(0, 0), matrix(0, 1), matrix(0, 2)),
+            osg::Vec3d(matrix(1, 0), matrix(1, 1), matrix(1, 2)),
+            osg::Vec3d(matrix(2, 0), matrix(2, 1), matrix(2, 2))
+        };
+
+        // without shear the largest row length is the largest stretch, otherwise fall back to the Frobenius norm which bounds it
+        double maxLength2 = std::max({rows[0].length2(), rows[1].length2(), rows[2].length2()});
+        double sumLength2 = rows[0].length2() + rows[1].length2() + rows[2].length2();
+        bool orthogonal = true;
+        for(int i=0; i<3; ++i)
+        {
+            int j = (i+1)%3;
+            if (std::abs(rows[i]*rows[j]) > 1e-6*std::sqrt(rows[i].length2()*rows[j].length2())) orthogonal = false;
+        }
+        double scale = std::sqrt(orthogonal ? maxLength2 : sumLength2);
+
+        osg::Vec3d center = osg::Vec3d(bound.center.x, bound.center.y, bound.center.z) * matrix;
+        return vsg::sphere(vsg::vec3(center.x(), center.y(), center.z()), static_cast<float>(bound.radius*scale*1.000001));
+    }
+}
+
+vsg::sphere SceneBuilder::getBoundingSphere(const osg::Geometry* geometry) const
+{
+    if (auto itr = boundingSpheres.find(geometry); itr != boundingSpheres.end()) return itr->second;
+
+    return buildOptions->tightBoundingSpheres ? computeBoundingSphere(geometry) : computeBoxBoundingSphere(geometry);
+}
+
+namespace
+{
+    // bytes of vertex and index data held by the commands convertToVsg() creates
+    class VertexDataSize : public vsg::Visitor
+    {
+    public:
+        uint64_t bytes = 0;
+
+        template<class T>
+        void add(const T& data) { if (data) bytes += data->dataSize(); }
+
+        void apply(vsg::Object& object) override { object.traverse(*this); }
+
+        void apply(vsg::Geometry& geometry) override
+        {
+            for(auto& array : geometry.arrays) add(array);
+            add(geometry.indices);
+        }
+
+        void apply(vsg::VertexIndexDraw& vid) override
+        {
+            for(auto& array : vid.arrays) add(array);
+            add(vid.indices);
+        }
+
+        void apply(vsg::BindVertexBuffers& bvb) override
+        {
+            for(auto& array : bvb.getArrays()) add(array);
+        }
+
+        void apply(vsg::BindIndexBuffer& bib) override { add(bib.getIndices()); }
+    };
+
+    uint64_t computeVertexDataSize(vsg::Command& command)
+    {
+        VertexDataSize vertexDataSize;
+        command.accept(vertexDataSize);
+        return vertexDataSize.bytes;
+    }
+}
+
+uint64_t SceneBuilder::computeGeometrySignature(const osg::Geometry* geometry, uint32_t geometryMask) const
+{
+    StateHash hash;
+    hash.add(geometry);
+    hash.add(geometryMask);
+    hash.add(static_cast<uint64_t>(buildOptions->geometryTarget));
+    hash.add(static_cast<uint64_t>(buildOptions->tightBoundingSpheres));
+
+    // osg::Array::dirty() increments the modification count, the binding and size are hashed too as changing them doesn't
+    auto addArray = [&](const osg::Array* array)
+    {
+        hash.add(array);
+        if (!array) return;
+
+        hash.add(array->getModifiedCount());
+        hash.add(array->getNumElements());
+        hash.add(static_cast<uint64_t>(array->getBinding()));
+    };
+
+    addArray(geometry->getVertexArray());
+    addArray(geometry->getNormalArray());
+    addArray(geometry->getColorArray());
+    addArray(geometry->getSecondaryColorArray());
+    addArray(geometry->getFogCoordArray());
+
+    hash.add(geometry->getNumTexCoordArrays());
+    for(unsigned int i=0; i<geometry->getNumTexCoordArrays(); ++i) addArray(geometry->getTexCoordArray(i));
+
+    hash.add(geometry->getNumVertexAttribArrays());
+    for(unsigned int i=0; i<geometry->getNumVertexAttribArrays(); ++i) addArray(geometry->getVertexAttribArray(i));
+
+    // DrawArrays ranges can be changed without dirtying the primitive set, so they are hashed as well
+    hash.add(geometry->getNumPrimitiveSets());
+    for(auto& primitive : geometry->getPrimitiveSetList())
+    {
+        hash.add(primitive.get());
+        hash.add(primitive->getModifiedCount());
+        hash.add(primitive->getMode());
+        hash.add(primitive->getNumIndices());
+        if (auto drawArrays = dynamic_cast<const osg::DrawArrays*>(primitive.get())) hash.add(static_cast<uint64_t>(drawArrays->getFirst()));
+    }
+
+    if (auto itr = flattenedGeometries.find(geometry); itr != flattenedGeometries.end())
+    {
+        hash.addBytes(matrices[itr->second].ptr(), sizeof(osg::Matrix::value_type)*16);
+    }
+
+    return hash.value;
+}
+
+uint64_t SceneBuilder::computeStateSignature(const osg::StateSet* stateset, uint32_t shaderModeMask) const
+{
+    StateHash hash;
+    hash.add(stateset);
+    hash.add(shaderModeMask);
+    hash.add(static_cast<uint64_t>(buildOptions->useBindDescriptorSet));
+    if (!stateset) return hash.value;
+
+    // materials are edited in place and have no modification count, so their values are hashed
+    if (auto material = dynamic_cast<const osg::Material*>(stateset->getAttribute(osg::StateAttribute::MATERIAL)))
+    {
+        osg::Vec4 colors[] = {material->getAmbient(osg::Material::FRONT), material->getDiffuse(osg::Material::FRONT), material->getSpecular(osg::Material::FRONT), material->getEmission(osg::Material::FRONT)};
+        float shininess = material->getShininess(osg::Material::FRONT);
+        hash.addBytes(colors, sizeof(colors));
+        hash.addBytes(&shininess, sizeof(shininess));
+    }
+
+    // textures that were reconverted have new DescriptorImages
+    for(uint32_t unit : {DIFFUSE_TEXTURE_UNIT, OPACITY_TEXTURE_UNIT, AMBIENT_TEXTURE_UNIT, NORMAL_TEXTURE_UNIT, SPECULAR_TEXTURE_UNIT})
+    {
+        auto texture = dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+        auto itr = texture ? texturesMap.find(TextureUnitPair(texture, unit)) : texturesMap.end();
+        const vsg::DescriptorImage* descriptorImage = (itr != texturesMap.end()) ? itr->second.get() : nullptr;
+        hash.add(descriptorImage);
+    }
+
+    return hash.value;
+}
+
+vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformGeometryMap& transformGeometryMap, vsg::Paths& /*searchPaths*/, uint32_t requiredGeomAttributesMask, CullItems* sortItems)
 {
     DEBUG_OUTPUT << "createTransformGeometryGraphVSG() " << transformGeometryMap.size() << std::endl;
 
     if (transformGeometryMap.empty()) return vsg::ref_ptr<vsg::Node>();
 
     vsg::ref_ptr<vsg::Group> group = vsg::Group::create();
-    for (auto[matrix, geometries] : transformGeometryMap)
+
+    // with a cull hierarchy the culled children of the group are collected, and the hierarchy built over them once they are all known
+    bool useCullHierarchy = buildOptions->buildCullHierarchy && (buildOptions->insertCullGroups || buildOptions->insertCullNodes) && !sortItems;
+    CullItems cullItems;
+    auto addCulledChild = [&](const vsg::sphere& bound, vsg::ref_ptr<vsg::Node> child)
+    {
+        if (sortItems) sortItems->push_back(CullItem{bound, child});
+        else if (useCullHierarchy) cullItems.push_back(CullItem{bound, child});
+        else group->addChild(child);
+    };
+
+    // flattened geometries have their matrix applied to their vertex data, so move them all to one batch drawn without a transform,
+    // along with any geometries that were already under an identity matrix
+    TransformGeometryMap flattenedTransformGeometryMap;
+    TransformGeometryMap* batches = &transformGeometryMap;
+    if (!flattenedGeometries.empty())
+    {
+        Geometries untransformed;
+        for (auto&[matrix, geometries] : transformGeometryMap)
+        {
+            Geometries transformed;
+            for (auto& geometry : geometries)
+            {
+                if (flattenedGeometries.count(geometry.get())>0 || matrix.isIdentity()) untransformed.push_back(geometry);
+                else transformed.push_back(geometry);
+            }
+
+            if (!transformed.empty()) flattenedTransformGeometryMap.emplace_back(matrix, std::move(transformed));
+        }
+
+        if (!untransformed.empty()) flattenedTransformGeometryMap.emplace(flattenedTransformGeometryMap.begin(), osg::Matrix(), std::move(untransformed));
+        batches = &flattenedTransformGeometryMap;
+    }
+
+    for (auto&[matrix, geometries] : *batches)
     {
         vsg::ref_ptr<vsg::Group> localGroup = group;
 
@@ -675,7 +1752,7 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformG
             localGroup = transform;
 
 
-            if (buildOptions->insertCullGroups || buildOptions->insertCullNodes)
+            if (buildOptions->insertCullGroups || buildOptions->insertCullNodes || sortItems)
             {
                 osg::BoundingBox overall_bb;
                 for (auto& geometry : geometries)
@@ -691,15 +1768,32 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformG
                 vsg::vec3 bb_max(overall_bb.xMax(), overall_bb.yMax(), overall_bb.zMax());
                 vsg::sphere boundingSphere((bb_min + bb_max)*0.5f, vsg::length(bb_max - bb_min)*0.5f);
 
-                if (buildOptions->insertCullNodes)
+                if (buildOptions->tightBoundingSpheres)
                 {
-                    group->addChild(vsg::CullNode::create(boundingSphere, transform));
+                    // merge the transformed spheres of the geometries, keeping whichever of that and the transformed box sphere is smaller
+                    CullItems transformedSpheres;
+                    for (auto& geometry : geometries)
+                    {
+                        transformedSpheres.push_back(CullItem{transformSphere(getBoundingSphere(geometry), matrix), {}});
+                    }
+
+                    auto mergedSphere = computeEnclosingSphere(transformedSpheres.begin(), transformedSpheres.end());
+                    if (mergedSphere.radius < boundingSphere.radius) boundingSphere = mergedSphere;
+                }
+
+                if (!buildOptions->insertCullGroups && !buildOptions->insertCullNodes)
+                {
+                    addCulledChild(boundingSphere, transform);
+                }
+                else if (buildOptions->insertCullNodes)
+                {
+                    addCulledChild(boundingSphere, vsg::CullNode::create(boundingSphere, transform));
                 }
                 else
                 {
                     auto cullGroup = vsg::CullGroup::create(boundingSphere);
                     cullGroup->addChild(transform);
-                    group->addChild(cullGroup);
+                    addCulledChild(boundingSphere, cullGroup);
                 }
             }
             else
@@ -752,42 +1846,41 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformG
         for (auto& geometry : geometries)
         {
 #if 1
+            // geometries are converted up front by createVSG(), so the geometriesMap is only read here and can be shared between threads
             vsg::ref_ptr<vsg::Command> leaf;
-            if(geometriesMap.find(geometry) != geometriesMap.end())
+            if (auto itr = geometriesMap.find(geometry); itr != geometriesMap.end())
             {
                 DEBUG_OUTPUT << "sharing geometry" << std::endl;
-                leaf = geometriesMap[geometry];
+                leaf = itr->second;
             }
             else
             {
                 leaf = convertToVsg(geometry, requiredGeomAttributesMask, buildOptions->geometryTarget);
-                if (leaf)
-                {
-                    geometriesMap[geometry] = leaf;
-                }
             }
 
             if (requiresLeafCullGroup)
             {
-                osg::BoundingBox bb = geometry->getBoundingBox();
-                vsg::vec3 bb_min(bb.xMin(), bb.yMin(), bb.zMin());
-                vsg::vec3 bb_max(bb.xMax(), bb.yMax(), bb.zMax());
+                vsg::sphere boundingSphere = getBoundingSphere(geometry);
 
-                vsg::sphere boundingSphere((bb_min + bb_max)*0.5f, vsg::length(bb_max - bb_min)*0.5f);
+                // leaf cull groups are only used when there is no transform, so the localGroup is the group
                 if (buildOptions->insertCullNodes)
                 {
                     DEBUG_OUTPUT<<"Using CullNode"<<std::endl;
-                    localGroup->addChild( vsg::CullNode::create(boundingSphere, leaf) );
+                    addCulledChild(boundingSphere, vsg::CullNode::create(boundingSphere, leaf));
                 }
                 else
                 {
                     DEBUG_OUTPUT<<"Using CullGroupe"<<std::endl;
                     auto cullGroup = vsg::CullGroup::create(boundingSphere);
                     cullGroup->addChild(leaf);
-                    localGroup->addChild(cullGroup);
+                    addCulledChild(boundingSphere, cullGroup);
                 }
             }
-            else
+            else if (sortItems && !requiresTransform)
+            {
+                addCulledChild(getBoundingSphere(geometry), leaf);
+            }
+            else
             {
                 localGroup->addChild(leaf);
             }
@@ -828,28 +1921,348 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformG
         }
     }
 
+    if (sortItems) return vsg::ref_ptr<vsg::Node>();
+
+    if (!cullItems.empty())
+    {
+        group->addChild(createCullHierarchy(std::move(cullItems), buildOptions->cullHierarchyFanOut));
+    }
+
     if (group->getNumChildren() == 1) return vsg::ref_ptr<vsg::Node>(group->getChild(0));
 
     return group;
 }
 
-vsg::ref_ptr<vsg::Node> SceneBuilder::createVSG(vsg::Paths& searchPaths)
+void SceneBuilder::computeTextureMaxDimensions()
+{
+    textureMaxDimensions.clear();
+    estimatedTextureMemory = 0;
+
+    if (buildOptions->textureMemoryBudget==0 && buildOptions->maxTextureDimension==0) return;
+
+    const uint32_t minDimension = 16;
+
+    struct TextureUsage
+    {
+        double requiredDimension = 0.0;
+        uint32_t dimension = 0;
+        double bytesPerTexel = 0.0;
+        bool measured = true; // false when any geometry using it has texcoords that can't be measured
+    };
+    std::map<const osg::Texture*, TextureUsage> usages;
+
+    // extent of texcoord array 0, which the shaders sample every texture with, or 0 when it is missing or not a 2D array
+    auto computeTexcoordExtent = [](const osg::Array* array) -> double
+    {
+        auto extent = [](auto texcoords) -> double
+        {
+            if (texcoords->empty()) return 0.0;
+
+            auto minTC = texcoords->front(), maxTC = texcoords->front();
+            for(auto& tc : *texcoords)
+            {
+                minTC.set(std::min(minTC.x(), tc.x()), std::min(minTC.y(), tc.y()));
+                maxTC.set(std::max(maxTC.x(), tc.x()), std::max(maxTC.y(), tc.y()));
+            }
+            return std::max<double>({maxTC.x()-minTC.x(), maxTC.y()-minTC.y(), 1e-3});
+        };
+
+        if (auto vec2Array = dynamic_cast<const osg::Vec2Array*>(array)) return extent(vec2Array);
+        if (auto vec2dArray = dynamic_cast<const osg::Vec2dArray*>(array)) return extent(vec2dArray);
+        return 0.0;
+    };
+
+    // record the world size and texcoord extent of each textured geometry, the extent is 0 when it can't be measured
+    struct Placement
+    {
+        const osg::Texture* texture;
+        double diameter;
+        double texcoordExtent;
+    };
+    std::vector<Placement> placements;
+    osg::BoundingSphere sceneBound;
+
+    for(auto& masksTransformStatePair : masksTransformStateMap)
+    {
+        for(auto& [matrix, stateGeometryMap] : masksTransformStatePair.second.matrixStateGeometryMap)
+        {
+            osg::Vec3d scale = matrix.getScale();
+            double maxScale = std::max({scale.x(), scale.y(), scale.z()});
+
+            for(auto& [stateset, geometries] : stateGeometryMap)
+            {
+                if (!stateset) continue;
+
+                std::vector<const osg::Texture*> textures;
+                for(unsigned int unit=0; unit<stateset->getNumTextureAttributeLists(); ++unit)
+                {
+                    auto texture = dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+                    if (texture && texture->getImage(0)) textures.push_back(texture);
+                }
+                if (textures.empty()) continue;
+
+                for(auto& geometry : geometries)
+                {
+                    const osg::BoundingBox& bb = geometry->getBoundingBox();
+                    if (!bb.valid()) continue;
+
+                    double radius = bb.radius()*maxScale;
+                    sceneBound.expandBy(osg::BoundingSphere(bb.center()*matrix, radius));
+
+                    double texcoordExtent = computeTexcoordExtent(geometry->getTexCoordArray(0));
+                    for(auto texture : textures) placements.push_back(Placement{texture, radius*2.0, texcoordExtent});
+                }
+            }
+        }
+    }
+
+    // the texels a texture needs is the screen size of the largest geometry it covers divided by the fraction of the texture spread across it
+    double sceneDiameter = std::max(sceneBound.radius()*2.0, 1e-6);
+    for(auto& placement : placements)
+    {
+        auto& usage = usages[placement.texture];
+        if (placement.texcoordExtent<=0.0)
+        {
+            usage.measured = false;
+            continue;
+        }
+
+        double screenSize = buildOptions->referenceScreenSize * std::min(1.0, placement.diameter/sceneDiameter);
+        usage.requiredDimension = std::max(usage.requiredDimension, screenSize/placement.texcoordExtent);
+    }
+
+    double totalBytes = 0.0;
+    for(auto& [texture, usage] : usages)
+    {
+        const osg::Image* image = texture->getImage(0);
+        usage.dimension = static_cast<uint32_t>(std::max(image->s(), image->t()));
+
+        // compressed images can't be downscaled so just count them against the budget
+        double aspect = static_cast<double>(image->s())*image->t()/(static_cast<double>(usage.dimension)*usage.dimension);
+        if (image->isCompressed())
+        {
+            totalBytes += image->getTotalSizeInBytesIncludingMipmaps();
+            continue;
+        }
+
+        // estimate the size of the format the converter will choose
+        const auto& formatProfile = buildOptions->formatProfile;
+        GLenum pixelFormat = image->getPixelFormat();
+        GLenum dataType = image->getDataType();
+        bool keepRGB = formatProfile.supportsRGB() && dataType==GL_UNSIGNED_BYTE;
+        if ((pixelFormat==GL_RGB || pixelFormat==GL_BGR) && !keepRGB) pixelFormat = GL_RGBA;
+        double bytesPerComponentScale = (dataType==GL_FLOAT && formatProfile.supportsHalfFloat()) ? 0.5 : 1.0;
+        usage.bytesPerTexel = aspect * ((buildOptions->textureCompression!=TEXTURE_COMPRESSION_NONE) ? 1.0 : bytesPerComponentScale*osg::Image::computePixelSizeInBits(pixelFormat, dataType)/8.0);
+
+        // mipmaps add a third
+        auto minFilter = texture->getFilter(osg::Texture::MIN_FILTER);
+        if (minFilter!=osg::Texture::NEAREST && minFilter!=osg::Texture::LINEAR) usage.bytesPerTexel *= 4.0/3.0;
+
+        if (buildOptions->maxTextureDimension>0)
+        {
+            while(usage.dimension>buildOptions->maxTextureDimension && usage.dimension>1) usage.dimension /= 2;
+        }
+
+        totalBytes += usage.bytesPerTexel * usage.dimension * usage.dimension;
+    }
+
+    // halve the textures that are most over resolved for their importance until the budget is met
+    if (buildOptions->textureMemoryBudget>0)
+    {
+        auto overResolution = [](const TextureUsage& usage) { return usage.dimension/std::max(usage.requiredDimension, 1.0); };
+
+        using Candidate = std::pair<double, const osg::Texture*>;
+        std::priority_queue<Candidate> candidates;
+        for(auto& [texture, usage] : usages)
+        {
+            // textures of unknown importance are left at their size rather than being treated as unimportant
+            if (usage.measured && usage.bytesPerTexel>0.0 && usage.dimension>minDimension) candidates.emplace(overResolution(usage), texture);
+        }
+
+        while(totalBytes>static_cast<double>(buildOptions->textureMemoryBudget) && !candidates.empty())
+        {
+            auto texture = candidates.top().second;
+            candidates.pop();
+
+            auto& usage = usages[texture];
+            double dimension = usage.dimension;
+            usage.dimension /= 2;
+            totalBytes -= usage.bytesPerTexel * (dimension*dimension - static_cast<double>(usage.dimension)*usage.dimension);
+
+            if (usage.dimension>minDimension) candidates.emplace(overResolution(usage), texture);
+        }
+    }
+
+    estimatedTextureMemory = static_cast<uint64_t>(totalBytes);
+
+    for(auto& [texture, usage] : usages)
+    {
+        const osg::Image* image = texture->getImage(0);
+        if (usage.dimension < static_cast<uint32_t>(std::max(image->s(), image->t()))) textureMaxDimensions[texture] = usage.dimension;
+    }
+
+    DEBUG_OUTPUT<<"computeTextureMaxDimensions() downscaling "<<textureMaxDimensions.size()<<" of "<<usages.size()<<" textures, estimated texture memory "<<totalBytes<<" bytes"<<std::endl;
+}
+
+vsg::ref_ptr<vsg::Node> SceneBuilder::createVSG(vsg::Paths& searchPaths, bool reusePreviousConversions)
 {
     DEBUG_OUTPUT<<"SceneBuilder::createVSG(vsg::Paths& searchPaths)"<<std::endl;
 
-    // clear caches
+    if (cancelled()) return {};
+
+    // once cancelled the remaining items of a phase are skipped and createVSG() returns null when the phase ends
+    auto pool = getOrCreateWorkerPool();
+    auto run = [&](size_t count, const std::function<void(size_t)>& func)
+    {
+        auto task = [&](size_t i) { if (!cancelled()) func(i); };
+        if (pool && count>1) pool->run(count, task);
+        else for(size_t i=0; i<count; ++i) task(i);
+    };
+
+    // clear caches, the conversions kept for updateVSG() too unless they are to be reused
     geometriesMap.clear();
     texturesMap.clear();
+    reconversionStats = ReconversionStats();
 
-    vsg::ref_ptr<vsg::Group> group = vsg::Group::create();
+    if (!reusePreviousConversions)
+    {
+        convertedGeometries.clear();
+        convertedTextures.clear();
+        convertedStates.clear();
+        convertedStateGraphs.clear();
+        bufferedMaterialValues.clear();
+        bufferedSamplerImages.clear();
+        materialPipelineLayout = nullptr;
+        materialDescriptorSet = nullptr;
+        bindMaterialBuffer = nullptr;
+        materialPushConstants.clear();
+        if (bindlessPipelineLayout) buildOptions->pipelineCache->removePipelines(bindlessPipelineLayout.get());
+        bindlessPipelineLayout = nullptr;
+        bindlessTextureCapacity = 0;
+    }
 
-    vsg::ref_ptr<vsg::Group> opaqueGroup = vsg::Group::create();
-    group->addChild(opaqueGroup);
+    beginPhase("group geometries");
+    groupGeometries();
+    if (!endPhase({geometryRecords.size(), 0})) return {};
 
-    vsg::ref_ptr<vsg::Group> transparentGroup = vsg::Group::create();
-    group->addChild(transparentGroup);
+    beginPhase("texture budget");
+
+    // geometries only ever drawn under one non identity matrix have it applied to their vertex data rather than being drawn under a transform
+    flattenedGeometries.clear();
+    if (buildOptions->flattenStaticTransforms)
+    {
+        const uint32_t notFlattened = std::numeric_limits<uint32_t>::max();
+        std::unordered_map<const osg::Geometry*, uint32_t> geometryMatrixIds;
+        for (auto& record : geometryRecords)
+        {
+            auto vertices = record.geometry->getVertexArray();
+            bool flatten = !matrices[record.matrixId].isIdentity() && (record.masks.first & BILLBOARD)==0 && !record.geometry->getComputeBoundingBoxCallback() &&
+                           (dynamic_cast<const osg::Vec3Array*>(vertices) || dynamic_cast<const osg::Vec3dArray*>(vertices));
+
+            auto [itr, inserted] = geometryMatrixIds.emplace(record.geometry.get(), flatten ? record.matrixId : notFlattened);
+            if (!inserted && itr->second!=record.matrixId) itr->second = notFlattened;
+        }
+
+        for (auto& [geometry, matrixId] : geometryMatrixIds)
+        {
+            if (matrixId!=notFlattened) flattenedGeometries[geometry] = matrixId;
+        }
+    }
+
+    computeTextureMaxDimensions();
+    if (!endPhase({textureMaxDimensions.size(), 0})) return {};
+
+    // convert the textures up front so the image conversions can be done in parallel
+    beginPhase("convert textures");
+    convertTextures(states);
+    {
+        PhaseStats stats{reconversionStats.numConvertedTextures, 0};
+        std::set<const vsg::Data*> textureData;
+        for (auto& [key, descriptorImage] : texturesMap)
+        {
+            for (auto& samplerImage : descriptorImage->getSamplerImages())
+            {
+                if (samplerImage.data && textureData.insert(samplerImage.data.get()).second) stats.bytes += samplerImage.data->dataSize();
+            }
+        }
+        if (!endPhase(stats)) return {};
+    }
+
+    beginPhase("create pipelines");
+
+    const uint32_t textureMaps = DIFFUSE_MAP | OPACITY_MAP | AMBIENT_MAP | NORMAL_MAP | SPECULAR_MAP;
+    const uint32_t textureUnits[] = {DIFFUSE_TEXTURE_UNIT, OPACITY_TEXTURE_UNIT, AMBIENT_TEXTURE_UNIT, NORMAL_TEXTURE_UNIT, SPECULAR_TEXTURE_UNIT};
 
-    for (auto[masks, transformStatePair] : masksTransformStateMap)
+    // devices that can't push the material index get per state material uniforms and texture descriptor sets instead
+    bool pushMaterialIndex = supportsMaterialBuffer(buildOptions->maxPushConstantsSize) && (buildOptions->supportedShaderModeMask & MATERIAL_BUFFER);
+    bool bindless = buildOptions->bindlessTextures && (buildOptions->supportedShaderModeMask & BINDLESS_TEXTURES) && pushMaterialIndex;
+    bool materialBuffer = bindless || (buildOptions->materialBuffer && pushMaterialIndex);
+
+    // bindless pipelines share one layout, with set 0 holding the material buffer and an array of every converted texture in the order the states first use them
+    std::map<TextureUnitPair, uint32_t> bindlessTextureIndices;
+    vsg::SamplerImages bindlessSamplerImages;
+    if (bindless)
+    {
+        std::map<const vsg::DescriptorImage*, uint32_t> imageIndices;
+        for (auto& stateset : states)
+        {
+            if (!stateset) continue;
+
+            for (auto unit : textureUnits)
+            {
+                auto texture = dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+                auto itr = texture ? texturesMap.find(TextureUnitPair(texture, unit)) : texturesMap.end();
+                if (itr == texturesMap.end() || !itr->second) continue;
+
+                // textures shared through the TextureRegistry or between units only take one element
+                auto [imageItr, inserted] = imageIndices.emplace(itr->second.get(), static_cast<uint32_t>(bindlessSamplerImages.size()));
+                if (inserted) bindlessSamplerImages.push_back(itr->second->getSamplerImages().front());
+                bindlessTextureIndices[itr->first] = imageItr->second;
+            }
+        }
+
+        // the array is sized to a power of two so the layout, and the pipelines created with it, are kept while the textures fit.
+        // outgrowing it replaces the layout, so the pipelines of the old one are removed from the cache rather than accumulating
+        uint32_t capacity = 0;
+        if (!bindlessSamplerImages.empty())
+        {
+            capacity = std::max(bindlessTextureCapacity, 16u);
+            while (capacity < bindlessSamplerImages.size()) capacity *= 2;
+        }
+
+        if (!bindlessPipelineLayout || capacity!=bindlessTextureCapacity)
+        {
+            if (bindlessPipelineLayout) buildOptions->pipelineCache->removePipelines(bindlessPipelineLayout.get());
+
+            vsg::DescriptorSetLayoutBindings descriptorBindings{{MATERIAL_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr}};
+            if (capacity > 0)
+            {
+                descriptorBindings.push_back({TEXTURE_ARRAY_BINDING, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr});
+            }
+
+            vsg::PushConstantRanges pushConstantRanges
+            {
+                {VK_SHADER_STAGE_VERTEX_BIT, 0, 128}, // projection and modelview matrices
+                {VK_SHADER_STAGE_FRAGMENT_BIT, MATERIAL_INDEX_PUSH_CONSTANT_OFFSET, sizeof(uint32_t)}
+            };
+
+            bindlessPipelineLayout = vsg::PipelineLayout::create(vsg::DescriptorSetLayouts{vsg::DescriptorSetLayout::create(descriptorBindings)}, pushConstantRanges);
+            bindlessTextureCapacity = capacity;
+        }
+    }
+    numBindlessTextures = static_cast<uint32_t>(bindlessSamplerImages.size());
+
+    // each masks entry gets its own pipeline, the entries are only combined again once they have all been converted
+    struct PipelineEntry
+    {
+        TransformStatePair* transformStatePair = nullptr;
+        uint32_t geometrymask = 0;
+        uint32_t shaderModeMask = 0;
+        vsg::ref_ptr<vsg::BindGraphicsPipeline> bindGraphicsPipeline;
+    };
+
+    std::vector<PipelineEntry> pipelineEntries;
+    for (auto&[masks, transformStatePair] : masksTransformStateMap)
     {
         unsigned int maxNumDescriptors = transformStatePair.stateTransformMap.size();
         if (maxNumDescriptors==0)
@@ -862,66 +2275,556 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createVSG(vsg::Paths& searchPaths)
             DEBUG_OUTPUT<<"  maxNumDescriptors = "<<maxNumDescriptors<<std::endl;
         }
 
-        uint32_t geometrymask = (masks.second | buildOptions->overrideGeomAttributes) & buildOptions->supportedGeometryAttributes;
-        uint32_t shaderModeMask = (masks.first | buildOptions->overrideShaderModeMask) & buildOptions->supportedShaderModeMask;
-        if (shaderModeMask & NORMAL_MAP) geometrymask |= TANGENT; // mesh propably won't have tangets so force them on if we want Normal mapping
+        PipelineEntry entry;
+        entry.transformStatePair = &transformStatePair;
+        entry.geometrymask = (masks.second | buildOptions->overrideGeomAttributes) & buildOptions->supportedGeometryAttributes;
+        entry.shaderModeMask = (masks.first | buildOptions->overrideShaderModeMask) & buildOptions->supportedShaderModeMask;
+        if (entry.shaderModeMask & NORMAL_MAP) entry.geometrymask |= TANGENT; // mesh propably won't have tangets so force them on if we want Normal mapping
+        if (bindless && (entry.shaderModeMask & (MATERIAL | textureMaps))) entry.shaderModeMask |= (MATERIAL_BUFFER | BINDLESS_TEXTURES);
+        else if (materialBuffer && (entry.shaderModeMask & MATERIAL)) entry.shaderModeMask |= MATERIAL_BUFFER;
 
-        DEBUG_OUTPUT<<"  about to call createStateSetWithGraphicsPipeline("<<shaderModeMask<<", "<<geometrymask<<", "<<maxNumDescriptors<<")"<<std::endl;
+        pipelineEntries.push_back(entry);
+    }
 
-        auto graphicsPipelineGroup = vsg::StateGroup::create();
+    run(pipelineEntries.size(), [&](size_t i)
+    {
+        auto& entry = pipelineEntries[i];
+        DEBUG_OUTPUT<<"  about to call createStateSetWithGraphicsPipeline("<<entry.shaderModeMask<<", "<<entry.geometrymask<<")"<<std::endl;
+        auto pipelineLayout = (entry.shaderModeMask & BINDLESS_TEXTURES) ? bindlessPipelineLayout : vsg::ref_ptr<vsg::PipelineLayout>();
+        entry.bindGraphicsPipeline = buildOptions->pipelineCache->getOrCreateBindGraphicsPipeline(entry.shaderModeMask, entry.geometrymask, buildOptions->vertexShaderPath, buildOptions->fragmentShaderPath, pipelineLayout);
+    });
+    if (!endPhase({pipelineEntries.size(), 0})) return {};
+
+    beginPhase("convert geometries");
+
+    // convert each geometry once, with the attributes of the first pipeline to use it, as converting them in order would.
+    // geometries converted by the previous createVSG() from the same arrays, primitive sets and matrix keep their commands
+    std::unordered_map<const osg::Geometry*, ConvertedGeometry> previousGeometries;
+    previousGeometries.swap(convertedGeometries);
+
+    std::vector<const osg::Geometry*> geometryOrder;
+    std::vector<std::pair<osg::Geometry*, uint32_t>> geometriesToConvert;
+    std::vector<uint64_t> geometrySignatures;
+    for (auto& entry : pipelineEntries)
+    {
+        if (!entry.bindGraphicsPipeline) continue;
 
-        auto bindGraphicsPipeline = buildOptions->pipelineCache->getOrCreateBindGraphicsPipeline(shaderModeMask, geometrymask, buildOptions->vertexShaderPath, buildOptions->fragmentShaderPath);
-        if (!bindGraphicsPipeline) continue;
+        for (auto& stateTransform : entry.transformStatePair->stateTransformMap)
+        {
+            for (auto& matrixGeometries : stateTransform.second)
+            {
+                for (auto& geometry : matrixGeometries.second)
+                {
+                    if (!geometriesMap.emplace(geometry.get(), nullptr).second) continue;
 
-        graphicsPipelineGroup->add(bindGraphicsPipeline);
+                    geometryOrder.push_back(geometry.get());
 
-        auto graphicsPipeline = bindGraphicsPipeline->pipeline;
-        auto& descriptorSetLayouts = graphicsPipeline->layout->setLayouts;
+                    uint64_t signature = computeGeometrySignature(geometry.get(), entry.geometrymask);
+                    auto itr = previousGeometries.find(geometry.get());
+                    if (itr != previousGeometries.end() && itr->second.signature==signature && !isDirty(geometry.get()))
+                    {
+                        convertedGeometries[geometry.get()] = std::move(itr->second);
+                        ++reconversionStats.numReusedGeometries;
+                    }
+                    else
+                    {
+                        geometriesToConvert.emplace_back(geometry.get(), entry.geometrymask);
+                        geometrySignatures.push_back(signature);
+                    }
+                }
+            }
+        }
+    }
+    previousGeometries.clear();
 
-        // attach based on use of transparency
-        if(shaderModeMask & BLEND)
+    // the bounding spheres are computed alongside, which also computes the geometries' bounding boxes before threads share them
+    std::vector<vsg::ref_ptr<vsg::Command>> commands(geometriesToConvert.size());
+    std::vector<vsg::sphere> spheres(geometriesToConvert.size());
+    std::vector<float> boxRadii(geometriesToConvert.size());
+    run(geometriesToConvert.size(), [&](size_t i)
+    {
+        osg::ref_ptr<osg::Geometry> geometry = geometriesToConvert[i].first;
+        if (auto itr = flattenedGeometries.find(geometry.get()); itr != flattenedGeometries.end())
         {
-            transparentGroup->addChild(graphicsPipelineGroup);
+            geometry = createTransformedGeometry(geometry.get(), matrices[itr->second]);
         }
-        else
+
+        commands[i] = convertToVsg(geometry.get(), geometriesToConvert[i].second, buildOptions->geometryTarget);
+        spheres[i] = buildOptions->tightBoundingSpheres ? computeBoundingSphere(geometry.get()) : computeBoxBoundingSphere(geometry.get());
+        boxRadii[i] = computeBoxBoundingSphere(geometry.get()).radius;
+    });
+
+    for (size_t i=0; i<geometriesToConvert.size(); ++i)
+    {
+        auto geometry = geometriesToConvert[i].first;
+        if (commands[i]) convertedGeometries[geometry] = ConvertedGeometry{geometry, geometrySignatures[i], commands[i], spheres[i], boxRadii[i]};
+    }
+    reconversionStats.numConvertedGeometries = static_cast<uint32_t>(geometriesToConvert.size());
+
+    boundingSpheres.clear();
+    double volumeRatioSum = 0.0;
+    size_t numVolumeRatios = 0;
+    for (auto geometry : geometryOrder)
+    {
+        auto itr = convertedGeometries.find(geometry);
+        if (itr == convertedGeometries.end())
         {
-            opaqueGroup->addChild(graphicsPipelineGroup);
+            geometriesMap.erase(geometry);
+            continue;
         }
 
-        for (auto[stateset, transformeGeometryMap] : transformStatePair.stateTransformMap)
+        auto& converted = itr->second;
+        geometriesMap[geometry] = converted.command;
+        boundingSpheres[geometry] = converted.bound;
+
+        if (converted.boxRadius > 0.0f)
         {
-            vsg::ref_ptr<vsg::Node> transformGeometryGraph = createTransformGeometryGraphVSG(transformeGeometryMap, searchPaths, geometrymask);
-            if (!transformGeometryGraph) continue;
+            double radiusRatio = converted.bound.radius / converted.boxRadius;
+            volumeRatioSum += radiusRatio*radiusRatio*radiusRatio;
+            ++numVolumeRatios;
+        }
+    }
+    averageSphereVolumeRatio = (numVolumeRatios>0) ? volumeRatioSum/double(numVolumeRatios) : 1.0;
+    {
+        PhaseStats stats{geometriesToConvert.size(), 0};
+        for (auto& command : commands)
+        {
+            if (command) stats.bytes += computeVertexDataSize(*command);
+        }
+        if (!endPhase(stats)) return {};
+    }
 
-            vsg::ref_ptr<vsg::DescriptorSet> descriptorSet = createVsgStateSet(descriptorSetLayouts.front(), stateset, shaderModeMask);
-            if (descriptorSet)
+    beginPhase("create state groups");
+
+    // build the subgraph of each state in parallel, the textures and geometries they need have all been converted already
+    struct StateEntry
+    {
+        const PipelineEntry* pipelineEntry = nullptr;
+        const osg::StateSet* stateset = nullptr;
+        TransformGeometryMap* transformGeometryMap = nullptr;
+        vsg::ref_ptr<vsg::Node> node;
+
+        // children to reorder for the view, depth sorted items are drawn from the transparent bin rather than from node
+        CullItems items;
+        bool depthSorted = false;
+        vsg::ref_ptr<vsg::Group> frontToBackGroup;
+
+        // index of the entry whose descriptor set this entry binds, its own unless a material buffer lets states share them
+        size_t descriptorOwner = 0;
+        vsg::ref_ptr<vsg::StateCommand> bindDescriptorSet;
+        vsg::ref_ptr<vsg::StateCommand> pushMaterialIndex;
+
+        // signature of the descriptor set this entry owns, and whether it and the subgraph were reused from the previous createVSG()
+        uint64_t stateSignature = 0;
+        bool reusedState = false;
+        bool reusedGraph = false;
+        uint64_t graphSignature = 0;
+    };
+
+    bool useCullHierarchy = buildOptions->buildCullHierarchy && (buildOptions->insertCullGroups || buildOptions->insertCullNodes);
+
+    std::vector<StateEntry> stateEntries;
+    for (auto& entry : pipelineEntries)
+    {
+        if (!entry.bindGraphicsPipeline) continue;
+
+        for (auto&[stateset, transformGeometryMap] : entry.transformStatePair->stateTransformMap)
+        {
+            stateEntries.push_back(StateEntry{&entry, stateset.get(), &transformGeometryMap, {}});
+            stateEntries.back().descriptorOwner = stateEntries.size()-1;
+        }
+    }
+
+    // gather the materials of MATERIAL_BUFFER states into one storage buffer, each state pushing the index of its material,
+    // so states of a pipeline that only differ in material can share one descriptor set, and bindless states need none at all
+    numBufferedMaterials = 0;
+    {
+        // std430 lays each material out as three vec4 colours, the shininess and the five texture indices, padded to 80 bytes
+        const size_t materialSize = 20;
+        using PackedMaterial = std::array<uint32_t, materialSize>;
+
+        std::vector<uint32_t> materialValues;
+        std::map<PackedMaterial, uint32_t> materialIndices;
+        std::map<std::pair<const PipelineEntry*, std::vector<const osg::StateAttribute*>>, size_t> descriptorOwners;
+        vsg::ref_ptr<vsg::PipelineLayout> pipelineLayout;
+
+        for (size_t i=0; i<stateEntries.size(); ++i)
+        {
+            auto& stateEntry = stateEntries[i];
+            uint32_t shaderModeMask = stateEntry.pipelineEntry->shaderModeMask;
+            if ((shaderModeMask & MATERIAL_BUFFER)==0) continue;
+
+            if (!pipelineLayout) pipelineLayout = stateEntry.pipelineEntry->bindGraphicsPipeline->pipeline->layout;
+
+            // states without a material use the defaults the shader uses when there is no MATERIAL
+            vsg::material value{vsg::vec4(0.1f, 0.1f, 0.1f, 1.0f), vsg::vec4(1.0f, 1.0f, 1.0f, 1.0f), vsg::vec4(0.3f, 0.3f, 0.3f, 1.0f), 16.0f};
+            auto osg_material = stateEntry.stateset ? dynamic_cast<const osg::Material*>(stateEntry.stateset->getAttribute(osg::StateAttribute::MATERIAL)) : nullptr;
+            if (osg_material) value = convertToMaterialValue(osg_material)->value();
+
+            PackedMaterial packed{};
+            std::memcpy(&packed[0], &value.ambientColor, sizeof(vsg::vec4));
+            std::memcpy(&packed[4], &value.diffuseColor, sizeof(vsg::vec4));
+            std::memcpy(&packed[8], &value.specularColor, sizeof(vsg::vec4));
+            std::memcpy(&packed[12], &value.shininess, sizeof(float));
+
+            std::vector<const osg::StateAttribute*> textures;
+            for (size_t t=0; t<std::size(textureUnits); ++t)
+            {
+                auto texture = stateEntry.stateset ? stateEntry.stateset->getTextureAttribute(textureUnits[t], osg::StateAttribute::TEXTURE) : nullptr;
+                if (shaderModeMask & BINDLESS_TEXTURES)
+                {
+                    auto itr = bindlessTextureIndices.find(TextureUnitPair(dynamic_cast<const osg::Texture*>(texture), textureUnits[t]));
+                    if (itr != bindlessTextureIndices.end()) packed[13+t] = itr->second;
+                }
+                else
+                {
+                    textures.push_back(texture);
+                }
+            }
+
+            auto [itr, inserted] = materialIndices.emplace(packed, static_cast<uint32_t>(materialIndices.size()));
+            if (inserted)
+            {
+                materialValues.insert(materialValues.end(), packed.begin(), packed.end());
+
+                // the push constants only hold the index, so those of earlier conversions are kept
+                if (materialPushConstants.size()<=itr->second)
+                {
+                    materialPushConstants.push_back(vsg::PushConstants::create(VK_SHADER_STAGE_FRAGMENT_BIT, MATERIAL_INDEX_PUSH_CONSTANT_OFFSET, vsg::uintValue::create(itr->second)));
+                }
+            }
+            stateEntry.pushMaterialIndex = materialPushConstants[itr->second];
+
+            stateEntry.descriptorOwner = descriptorOwners.emplace(std::make_pair(stateEntry.pipelineEntry, std::move(textures)), i).first->second;
+        }
+
+        auto sameSamplerImages = [](const vsg::SamplerImages& lhs, const vsg::SamplerImages& rhs)
+        {
+            return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const vsg::SamplerImage& l, const vsg::SamplerImage& r) { return l.sampler==r.sampler && l.data==r.data; });
+        };
+
+        // the buffer and its descriptor set are kept when the materials, textures and layout are those of the previous conversion
+        bool reuseMaterialBuffer = bindMaterialBuffer && materialValues==bufferedMaterialValues && pipelineLayout==materialPipelineLayout && sameSamplerImages(bindlessSamplerImages, bufferedSamplerImages);
+        if (materialValues.empty())
+        {
+            materialDescriptorSet = nullptr;
+            bindMaterialBuffer = nullptr;
+        }
+        else if (!reuseMaterialBuffer)
+        {
+            auto materialData = vsg::uintArray::create(static_cast<uint32_t>(materialValues.size()));
+            std::copy(materialValues.begin(), materialValues.end(), materialData->begin());
+
+            vsg::Descriptors descriptors{vsg::DescriptorBuffer::create(materialData, MATERIAL_BINDING, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)};
+            if (!bindlessSamplerImages.empty())
             {
-                auto stategroup = vsg::StateGroup::create();
-                graphicsPipelineGroup->addChild(stategroup);
-                stategroup->addChild(transformGeometryGraph);
+                // the unused elements repeat the first texture as every element of the array has to be written
+                auto samplerImages = bindlessSamplerImages;
+                samplerImages.resize(bindlessTextureCapacity, bindlessSamplerImages.front());
+                descriptors.push_back(vsg::DescriptorImage::create(samplerImages, TEXTURE_ARRAY_BINDING, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER));
+            }
+
+            materialDescriptorSet = vsg::DescriptorSet::create(pipelineLayout->setLayouts.front(), descriptors);
+            bindMaterialBuffer = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, materialDescriptorSet);
+        }
+
+        numBufferedMaterials = static_cast<uint32_t>(materialIndices.size());
+        bufferedMaterialValues = std::move(materialValues);
+        bufferedSamplerImages = bindlessSamplerImages;
+        materialPipelineLayout = pipelineLayout;
+    }
+
+    // owners of descriptor sets keep those of the previous conversion when the material and textures they were created from are unchanged
+    std::map<StateKey, ConvertedState> previousStates;
+    previousStates.swap(convertedStates);
+    std::map<StateKey, ConvertedStateGraph> previousStateGraphs;
+    previousStateGraphs.swap(convertedStateGraphs);
+
+    auto stateKey = [](const StateEntry& stateEntry) { return StateKey(stateEntry.pipelineEntry->bindGraphicsPipeline.get(), stateEntry.stateset); };
+
+    for (size_t i=0; i<stateEntries.size(); ++i)
+    {
+        auto& stateEntry = stateEntries[i];
+        if (stateEntry.descriptorOwner!=i) continue;
+
+        stateEntry.stateSignature = computeStateSignature(stateEntry.stateset, stateEntry.pipelineEntry->shaderModeMask);
+        if (auto itr = previousStates.find(stateKey(stateEntry)); itr != previousStates.end() && itr->second.signature==stateEntry.stateSignature)
+        {
+            stateEntry.bindDescriptorSet = itr->second.bindDescriptorSet;
+            stateEntry.reusedState = true;
+        }
+    }
 
+    run(stateEntries.size(), [&](size_t i)
+    {
+        auto& stateEntry = stateEntries[i];
+        auto& pipelineEntry = *stateEntry.pipelineEntry;
+
+        // the descriptor set is created before the subgraph as entries sharing it need it even if the owner draws nothing
+        if (stateEntry.descriptorOwner==i && !stateEntry.reusedState)
+        {
+            auto graphicsPipeline = pipelineEntry.bindGraphicsPipeline->pipeline;
+            auto& descriptorSetLayouts = graphicsPipeline->layout->setLayouts;
+
+            // MATERIAL_BUFFER pipelines have the material buffer in set 0 and the per state set in set 1
+            uint32_t stateSetIndex = (pipelineEntry.shaderModeMask & MATERIAL_BUFFER) ? 1 : 0;
+
+            vsg::ref_ptr<vsg::DescriptorSet> descriptorSet = createVsgStateSet(descriptorSetLayouts[stateSetIndex], stateEntry.stateset, pipelineEntry.shaderModeMask);
+            if (descriptorSet)
+            {
                 if (buildOptions->useBindDescriptorSet)
                 {
-                    auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->layout, 0, descriptorSet);
-                    stategroup->add(bindDescriptorSet);
+                    stateEntry.bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->layout, stateSetIndex, descriptorSet);
                 }
                 else
                 {
-                    auto bindDescriptorSets = vsg::BindDescriptorSets::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->layout, 0, vsg::DescriptorSets{descriptorSet});
-                    stategroup->add(bindDescriptorSets);
+                    stateEntry.bindDescriptorSet = vsg::BindDescriptorSets::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->layout, stateSetIndex, vsg::DescriptorSets{descriptorSet});
                 }
             }
-            else
+        }
+
+        bool blended = (pipelineEntry.shaderModeMask & BLEND)!=0;
+        bool depthSort = blended && buildOptions->depthSortTransparent;
+        bool frontToBack = !blended && buildOptions->frontToBackOpaque && !useCullHierarchy;
+
+        // the subgraph of the previous conversion is reused when it would be built from the same matrices, geometry commands and material index
+        StateHash graphHash;
+        graphHash.add(static_cast<uint64_t>(depthSort));
+        graphHash.add(static_cast<uint64_t>(frontToBack));
+        graphHash.add(stateEntry.pushMaterialIndex.get());
+        for (auto& [matrix, geometries] : *stateEntry.transformGeometryMap)
+        {
+            graphHash.addBytes(matrix.ptr(), sizeof(osg::Matrix::value_type)*16);
+            graphHash.add(geometries.size());
+            for (auto& geometry : geometries)
+            {
+                auto itr = geometriesMap.find(geometry.get());
+                const vsg::Command* command = (itr != geometriesMap.end()) ? itr->second.get() : nullptr;
+                graphHash.add(command);
+            }
+        }
+        stateEntry.graphSignature = graphHash.value;
+
+        if (auto itr = previousStateGraphs.find(stateKey(stateEntry)); itr != previousStateGraphs.end() && itr->second.signature==stateEntry.graphSignature)
+        {
+            auto& previous = itr->second;
+            stateEntry.node = previous.node;
+            stateEntry.items = previous.items;
+            stateEntry.depthSorted = previous.depthSorted;
+            stateEntry.frontToBackGroup = previous.frontToBackGroup;
+            stateEntry.reusedGraph = true;
+
+            // the previous ViewSorter may have reordered the group, the new one expects the children in the order of the items
+            if (stateEntry.frontToBackGroup)
             {
-                graphicsPipelineGroup->addChild(transformGeometryGraph);
+                vsg::Group::Children children;
+                for (auto& item : stateEntry.items) children.push_back(item.node);
+                stateEntry.frontToBackGroup->setChildren(children);
             }
+            return;
+        }
+
+        vsg::ref_ptr<vsg::Node> transformGeometryGraph;
+        if (depthSort || frontToBack)
+        {
+            CullItems items;
+            createTransformGeometryGraphVSG(*stateEntry.transformGeometryMap, searchPaths, pipelineEntry.geometrymask, &items);
+            if (items.empty()) return;
+
+            if (!depthSort && items.size()==1)
+            {
+                transformGeometryGraph = items.front().node;
+            }
+            else if (!depthSort)
+            {
+                auto frontToBackGroup = vsg::Group::create();
+                for (auto& item : items) frontToBackGroup->addChild(item.node);
+                transformGeometryGraph = frontToBackGroup;
+                stateEntry.frontToBackGroup = frontToBackGroup;
+            }
+
+            stateEntry.items = std::move(items);
+            stateEntry.depthSorted = depthSort;
         }
+        else
+        {
+            transformGeometryGraph = createTransformGeometryGraphVSG(*stateEntry.transformGeometryMap, searchPaths, pipelineEntry.geometrymask);
+            if (!transformGeometryGraph) return;
+        }
+
+        if (!stateEntry.depthSorted && stateEntry.pushMaterialIndex)
+        {
+            auto stategroup = vsg::StateGroup::create();
+            stategroup->add(stateEntry.pushMaterialIndex);
+            stategroup->addChild(transformGeometryGraph);
+            transformGeometryGraph = stategroup;
+        }
+
+        stateEntry.node = transformGeometryGraph;
+    });
+
+    // keep the descriptor sets and subgraphs for the next updateVSG()
+    for (size_t i=0; i<stateEntries.size(); ++i)
+    {
+        auto& stateEntry = stateEntries[i];
+        auto key = stateKey(stateEntry);
+
+        if (stateEntry.descriptorOwner==i)
+        {
+            convertedStates[key] = ConvertedState{stateEntry.stateset, stateEntry.stateSignature, stateEntry.bindDescriptorSet};
+            if (stateEntry.bindDescriptorSet && stateEntry.reusedState) ++reconversionStats.numReusedDescriptorSets;
+            else if (stateEntry.bindDescriptorSet) ++reconversionStats.numCreatedDescriptorSets;
+        }
+
+        if (stateEntry.node || !stateEntry.items.empty())
+        {
+            convertedStateGraphs[key] = ConvertedStateGraph{stateEntry.stateset, stateEntry.graphSignature, stateEntry.node, stateEntry.items, stateEntry.depthSorted, stateEntry.frontToBackGroup};
+            if (stateEntry.reusedGraph) ++reconversionStats.numReusedStateGraphs;
+            else ++reconversionStats.numCreatedStateGraphs;
+        }
+    }
+    previousStates.clear();
+    previousStateGraphs.clear();
+
+    // textures the scene no longer uses aren't kept
+    for (auto itr = convertedTextures.begin(); itr != convertedTextures.end();)
+    {
+        auto current = texturesMap.find(itr->first);
+        bool used = current != texturesMap.end() && current->second==itr->second.descriptorImage;
+        itr = used ? std::next(itr) : convertedTextures.erase(itr);
+    }
+    if (!endPhase({reconversionStats.numCreatedDescriptorSets, bufferedMaterialValues.size()*sizeof(uint32_t)})) return {};
+
+    beginPhase("assemble");
+
+    // assemble the pipeline groups in masks order, so the scene graph is the same however the work was scheduled
+    vsg::ref_ptr<vsg::Group> group = vsg::Group::create();
+
+    vsg::ref_ptr<vsg::Group> opaqueGroup = vsg::Group::create();
+    group->addChild(opaqueGroup);
+
+    vsg::ref_ptr<vsg::Group> transparentGroup = vsg::Group::create();
+    group->addChild(transparentGroup);
+
+    viewSorter = (buildOptions->depthSortTransparent || buildOptions->frontToBackOpaque) ? ViewSorter::create() : vsg::ref_ptr<ViewSorter>();
+
+    auto toCentre = [](const vsg::sphere& bound) { return vsg::dvec3(bound.center.x, bound.center.y, bound.center.z); };
+
+    // the blended items of every state share one bin so they can be sorted against each other
+    vsg::ref_ptr<vsg::Group> depthSortedBin;
+    std::vector<vsg::dvec3> depthSortedCentres;
+
+    numStateDescriptorSets = 0;
+    for (auto& stateEntry : stateEntries)
+    {
+        if (stateEntry.bindDescriptorSet) ++numStateDescriptorSets;
     }
 
+    // MATERIAL_BUFFER pipelines bind the material buffer as set 0 alongside themselves, with their own layout, so it is bound
+    // at every draw whatever the pipelines of other states bind in between
+    std::map<const vsg::PipelineLayout*, vsg::ref_ptr<vsg::StateCommand>> materialBinds;
+    auto bindMaterials = [&](const PipelineEntry& entry)
+    {
+        vsg::ref_ptr<vsg::StateCommand> bind;
+        if ((entry.shaderModeMask & MATERIAL_BUFFER)==0 || !materialDescriptorSet) return bind;
+
+        auto& layout = entry.bindGraphicsPipeline->pipeline->layout;
+        bind = materialBinds[layout.get()];
+        if (!bind)
+        {
+            bind = (layout==materialPipelineLayout) ? bindMaterialBuffer : vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, materialDescriptorSet);
+            materialBinds[layout.get()] = bind;
+        }
+        return bind;
+    };
+
+    auto stateEntryItr = stateEntries.begin();
+    for (auto& entry : pipelineEntries)
+    {
+        if (!entry.bindGraphicsPipeline) continue;
+
+        auto bindMaterialSet = bindMaterials(entry);
+
+        auto graphicsPipelineGroup = vsg::StateGroup::create();
+        graphicsPipelineGroup->add(entry.bindGraphicsPipeline);
+        if (bindMaterialSet) graphicsPipelineGroup->add(bindMaterialSet);
+
+        // the state group binding each descriptor set, keyed by the index of the entry that owns it
+        std::map<size_t, vsg::ref_ptr<vsg::StateGroup>> descriptorGroups;
+
+        for (; stateEntryItr != stateEntries.end() && stateEntryItr->pipelineEntry == &entry; ++stateEntryItr)
+        {
+            auto& owner = stateEntries[stateEntryItr->descriptorOwner];
+
+            if (stateEntryItr->depthSorted)
+            {
+                if (!depthSortedBin) depthSortedBin = vsg::Group::create();
+                for (auto& item : stateEntryItr->items)
+                {
+                    // each depth sorted item binds its own pipeline and descriptor set as the bin interleaves items of different states
+                    auto stategroup = vsg::StateGroup::create();
+                    stategroup->add(entry.bindGraphicsPipeline);
+                    if (bindMaterialSet) stategroup->add(bindMaterialSet);
+                    if (owner.bindDescriptorSet) stategroup->add(owner.bindDescriptorSet);
+                    if (stateEntryItr->pushMaterialIndex) stategroup->add(stateEntryItr->pushMaterialIndex);
+                    stategroup->addChild(item.node);
+
+                    depthSortedBin->addChild(stategroup);
+                    depthSortedCentres.push_back(toCentre(item.bound));
+                }
+                continue;
+            }
+
+            if (stateEntryItr->node && owner.bindDescriptorSet)
+            {
+                auto& descriptorGroup = descriptorGroups[stateEntryItr->descriptorOwner];
+                if (!descriptorGroup)
+                {
+                    descriptorGroup = vsg::StateGroup::create();
+                    descriptorGroup->add(owner.bindDescriptorSet);
+                    graphicsPipelineGroup->addChild(descriptorGroup);
+                }
+                descriptorGroup->addChild(stateEntryItr->node);
+            }
+            else if (stateEntryItr->node)
+            {
+                graphicsPipelineGroup->addChild(stateEntryItr->node);
+            }
+
+            if (stateEntryItr->frontToBackGroup)
+            {
+                std::vector<vsg::dvec3> centres;
+                for (auto& item : stateEntryItr->items) centres.push_back(toCentre(item.bound));
+                viewSorter->addFrontToBackGroup(stateEntryItr->frontToBackGroup, centres);
+            }
+        }
+
+        // pipelines whose states were all moved to the depth sorted bin have nothing left to draw
+        if (graphicsPipelineGroup->getNumChildren()==0) continue;
+
+        // attach based on use of transparency
+        if(entry.shaderModeMask & BLEND)
+        {
+            transparentGroup->addChild(graphicsPipelineGroup);
+        }
+        else
+        {
+            opaqueGroup->addChild(graphicsPipelineGroup);
+        }
+    }
+
+    if (depthSortedBin)
+    {
+        transparentGroup->addChild(depthSortedBin);
+        viewSorter->addDepthSortedGroup(depthSortedBin, depthSortedCentres);
+    }
+    if (!endPhase({stateEntries.size(), 0})) return {};
 
     // if we are using CullGroups then place one at the top of the created scene graph
     if (buildOptions->insertCullGroups)
     {
+        beginPhase("compute bounds");
+
         vsg::ComputeBounds computeBounds;
         group->accept(computeBounds);
 
@@ -933,13 +2836,56 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createVSG(vsg::Paths& searchPaths)
 
         // now use the cullGroup as the root.
         group = cullGroup;
+
+        if (!endPhase({1, 0})) return {};
     }
 
     return group;
 }
 
+void SceneBuilder::beginPhase(const char* phase)
+{
+    currentPhase = phase;
+    phaseStart = std::chrono::steady_clock::now();
+
+    if (buildOptions->observer) buildOptions->observer->beginPhase(currentPhase);
+}
+
+bool SceneBuilder::endPhase(const PhaseStats& stats)
+{
+    double milliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - phaseStart).count();
+    phaseTimings.emplace_back(currentPhase, milliseconds);
+
+    if (buildOptions->observer) buildOptions->observer->endPhase(currentPhase, stats, milliseconds);
+
+    // the caller cancelled the conversion so already knows, the phase it stopped in is the last one reported to the observer
+    return !cancelled();
+}
+
+void SceneBuilder::printPhaseTimings(std::ostream& out) const
+{
+    double total = 0.0;
+    for(auto& [phase, milliseconds] : phaseTimings)
+    {
+        out<<"createVSG() "<<phase<<" time = "<<milliseconds<<"ms"<<std::endl;
+        total += milliseconds;
+    }
+    out<<"createVSG() total time = "<<total<<"ms"<<std::endl;
+}
+
 vsg::ref_ptr<vsg::Node> SceneBuilder::optimizeAndConvertToVsg(osg::ref_ptr<osg::Node> osg_scene, vsg::Paths& searchPaths)
 {
+    phaseTimings.clear();
+
+    beginPhase("optimize");
+
+    // atlas first, so the optimizer's SHARE_DUPLICATE_STATE merges the statesets that now share an atlas
+    if (buildOptions->maxTextureAtlasSize>0)
+    {
+        OptimizeOsgTextureAtlases optimizeTextureAtlases(buildOptions->maxTextureAtlasSize);
+        optimizeTextureAtlases.optimize(osg_scene);
+    }
+
     bool optimize = true;
     if (optimize)
     {
@@ -966,7 +2912,10 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::optimizeAndConvertToVsg(osg::ref_ptr<osg::
         optimizeBillboards.optimize();
     }
 
-    osg_scene->accept(*this);
+    if (!endPhase()) return {};
+
+    traverseScene(*osg_scene);
+    if (cancelled()) return {};
 
     // build VSG scene
     return createVSG(searchPaths);
@@ -47,6 +47,28 @@ uint32_t osg2vsg::calculateShaderModeMask(const osg::StateSet* stateSet)
     return stateMask;
 }
 
+bool osg2vsg::supportsBindlessTextures(VkPhysicalDevice physicalDevice, uint32_t numTextures)
+{
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    // the textures array is indexed with nonuniformEXT and declared without a size, and the material index is pushed after the 128 bytes of matrices
+    return indexingFeatures.shaderSampledImageArrayNonUniformIndexing && indexingFeatures.runtimeDescriptorArray &&
+           supportsMaterialBuffer(properties.limits.maxPushConstantsSize) &&
+           properties.limits.maxPerStageDescriptorSamplers >= numTextures &&
+           properties.limits.maxPerStageDescriptorSampledImages >= numTextures &&
+           properties.limits.maxDescriptorSetSamplers >= numTextures &&
+           properties.limits.maxDescriptorSetSampledImages >= numTextures;
+}
+
 // create defines string based of shader mask
 
 static std::vector<std::string> createPSCDefineStrings(const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes)
@@ -68,17 +90,22 @@ static std::vector<std::string> createPSCDefineStrings(const uint32_t& shaderMod
     if (hasnormal && (shaderModeMask & LIGHTING)) defines.push_back("VSG_LIGHTING");
     
     if(shaderModeMask & MATERIAL) defines.push_back("VSG_MATERIAL");
+    if(shaderModeMask & MATERIAL_BUFFER) defines.push_back("VSG_MATERIAL_BUFFER");
+    if(shaderModeMask & BINDLESS_TEXTURES) defines.push_back("VSG_BINDLESS_TEXTURES");
 
     if (hastex0 && (shaderModeMask & DIFFUSE_MAP)) defines.push_back("VSG_DIFFUSE_MAP");
     if (hastex0 && (shaderModeMask & OPACITY_MAP)) defines.push_back("VSG_OPACITY_MAP");
     if (hastex0 && (shaderModeMask & AMBIENT_MAP)) defines.push_back("VSG_AMBIENT_MAP");
     if (hastex0 && (shaderModeMask & NORMAL_MAP)) defines.push_back("VSG_NORMAL_MAP");
+    if (hastex0 && (shaderModeMask & NORMAL_MAP) && (shaderModeMask & NORMAL_MAP_XY)) defines.push_back("VSG_NORMAL_MAP_XY");
     if (hastex0 && (shaderModeMask & SPECULAR_MAP)) defines.push_back("VSG_SPECULAR_MAP");
 
     if (shaderModeMask & BILLBOARD) defines.push_back("VSG_BILLBOARD");
 
     if (shaderModeMask & SHADER_TRANSLATE) defines.push_back("VSG_TRANSLATE");
 
+    if (shaderModeMask & ALPHA_TEST) defines.push_back("VSG_ALPHA_TEST");
+
     return defines;
 }
 
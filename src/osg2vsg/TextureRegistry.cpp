@@ -0,0 +1,241 @@
+#include <osg2vsg/TextureRegistry.h>
+#include <osg2vsg/GeometryUtils.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace osg2vsg;
+
+namespace
+{
+    // FNV-1a over 64 bit words rather than bytes, so hashing large images is fast. the high bits are folded back
+    // after each multiply, as it only carries changes upwards.
+    struct Hash
+    {
+        uint64_t value = 14695981039346656037ull;
+
+        void mix(uint64_t word)
+        {
+            value ^= word;
+            value *= 1099511628211ull;
+            value ^= value >> 32;
+        }
+
+        void add(const void* ptr, size_t size)
+        {
+            auto bytes = static_cast<const uint8_t*>(ptr);
+            size_t i = 0;
+            for(; i+sizeof(uint64_t)<=size; i+=sizeof(uint64_t))
+            {
+                uint64_t word;
+                std::memcpy(&word, bytes+i, sizeof(uint64_t));
+                mix(word);
+            }
+            for(; i<size; ++i) mix(bytes[i]);
+        }
+
+        template<typename T>
+        void add(const T& v) { add(&v, sizeof(T)); }
+    };
+
+    bool sameOptions(const ImageOptions& lhs, const ImageOptions& rhs)
+    {
+        return lhs.mipmapFilter==rhs.mipmapFilter && lhs.sRGB==rhs.sRGB && lhs.compression==rhs.compression && lhs.role==rhs.role &&
+               lhs.maxDimension==rhs.maxDimension && lhs.allowRGB==rhs.allowRGB && lhs.halfFloat==rhs.halfFloat && lhs.dropOpaqueAlpha==rhs.dropOpaqueAlpha;
+    }
+}
+
+const void* TextureRegistry::ImageEntry::contents() const
+{
+    if (size==0) return nullptr;
+    if (source) return source->data();
+    return data ? data->dataPointer() : nullptr;
+}
+
+uint64_t TextureRegistry::ImageEntry::numBytes() const
+{
+    uint64_t bytes = data ? data->dataSize() : 0;
+    if (source) bytes += size;
+    return bytes;
+}
+
+TextureRegistry::ImageEntry TextureRegistry::describe(const osg::Image* image, const ImageOptions& options)
+{
+    ImageEntry entry;
+    entry.options = options;
+    if (image)
+    {
+        entry.s = image->s();
+        entry.t = image->t();
+        entry.r = image->r();
+        entry.pixelFormat = image->getPixelFormat();
+        entry.dataType = image->getDataType();
+        entry.packing = image->getPacking();
+        entry.origin = image->getOrigin();
+        entry.size = image->data() ? image->getTotalSizeInBytesIncludingMipmaps() : 0;
+        entry.source = image;
+    }
+    return entry;
+}
+
+bool TextureRegistry::sameImage(const ImageEntry& lhs, const ImageEntry& rhs)
+{
+    if (lhs.s!=rhs.s || lhs.t!=rhs.t || lhs.r!=rhs.r || lhs.pixelFormat!=rhs.pixelFormat || lhs.dataType!=rhs.dataType ||
+        lhs.packing!=rhs.packing || lhs.origin!=rhs.origin || lhs.size!=rhs.size || !sameOptions(lhs.options, rhs.options)) return false;
+
+    if (lhs.size==0) return true;
+
+    // contents that are no longer available can't be confirmed to match
+    auto lhsContents = lhs.contents();
+    auto rhsContents = rhs.contents();
+    if (!lhsContents || !rhsContents) return false;
+
+    return lhsContents==rhsContents || std::memcmp(lhsContents, rhsContents, lhs.size)==0;
+}
+
+uint64_t TextureRegistry::computeHash(const osg::Image* image, const ImageOptions& options)
+{
+    Hash hash;
+    hash.add(options.mipmapFilter);
+    hash.add(options.sRGB);
+    hash.add(options.compression);
+    hash.add(options.role);
+    hash.add(options.maxDimension);
+    hash.add(options.allowRGB);
+    hash.add(options.halfFloat);
+    hash.add(options.dropOpaqueAlpha);
+
+    if (image)
+    {
+        hash.add(image->s());
+        hash.add(image->t());
+        hash.add(image->r());
+        hash.add(image->getPixelFormat());
+        hash.add(image->getDataType());
+        hash.add(image->getPacking());
+        hash.add(image->getOrigin());
+        if (image->data()) hash.add(image->data(), image->getTotalSizeInBytesIncludingMipmaps());
+    }
+
+    return hash.value;
+}
+
+vsg::ref_ptr<vsg::Data> TextureRegistry::getOrCreateData(const osg::Image* image, const ImageOptions& options)
+{
+    auto hash = computeHash(image, options);
+    auto request = describe(image, options);
+
+    // entries with the same hash are compared outside the lock, as comparing the contents of large images is slow
+    std::vector<ImageEntry> candidates;
+    uint64_t requestNumber = 0;
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        requestNumber = ++_numImageRequests;
+        for(auto [itr, end] = _images.equal_range(hash); itr != end; ++itr) candidates.push_back(itr->second);
+    }
+
+    for(auto& candidate : candidates)
+    {
+        if (!sameImage(candidate, request)) continue;
+
+        std::lock_guard<std::mutex> guard(_mutex);
+        for(auto [itr, end] = _images.equal_range(hash); itr != end; ++itr)
+        {
+            if (itr->second.data==candidate.data) itr->second.lastRequest = requestNumber;
+        }
+        return candidate.data;
+    }
+
+    // convert outside the lock so other threads can convert different images at the same time
+    auto data = convertToVsg(image, options);
+    if (!data) return {};
+
+    // keep the source to compare later requests against, unless its data was moved into data
+    ImageEntry entry = request;
+    if (image && !image->data()) entry.source = nullptr;
+    entry.data = data;
+    entry.lastRequest = requestNumber;
+
+    // another thread may have converted the same image in the meantime, in which case use its result
+    std::lock_guard<std::mutex> guard(_mutex);
+    for(auto [itr, end] = _images.equal_range(hash); itr != end; ++itr)
+    {
+        if (sameImage(itr->second, entry)) return itr->second.data;
+    }
+    _images.emplace(hash, std::move(entry));
+    return data;
+}
+
+vsg::ref_ptr<vsg::DescriptorImage> TextureRegistry::getOrCreateDescriptorImage(const osg::Texture* texture, uint32_t binding, const ImageOptions& options)
+{
+    const osg::Image* image = texture ? texture->getImage(0) : nullptr;
+
+    // the sampler's maxLod is computed from the image, so create it before the image's data may be released
+    auto sampler = samplerCache->getOrCreateSampler(texture, options.maxDimension);
+
+    auto data = getOrCreateData(image, options);
+    if (!data) return {};
+
+    // share the DescriptorImage too, so the image is only compiled and uploaded to the GPU once
+    std::lock_guard<std::mutex> guard(_mutex);
+    auto& descriptorImage = _descriptorImages[DescriptorImageKey(data.get(), sampler.get(), binding)];
+    if (!descriptorImage)
+    {
+        descriptorImage = vsg::DescriptorImage::create(sampler, data, binding, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    }
+    return descriptorImage;
+}
+
+TextureRegistry::Stats TextureRegistry::getStats() const
+{
+    std::lock_guard<std::mutex> guard(_mutex);
+
+    Stats stats;
+    stats.numImageRequests = _numImageRequests;
+    stats.numUniqueImages = _images.size();
+    stats.numUniqueSamplers = samplerCache->size();
+    stats.numUniqueDescriptorImages = _descriptorImages.size();
+    for(auto& [hash, entry] : _images) stats.numBytes += entry.numBytes();
+    return stats;
+}
+
+void TextureRegistry::releaseUnused(uint64_t maxUnusedBytes)
+{
+    std::lock_guard<std::mutex> guard(_mutex);
+
+    // DescriptorImages are cheap to recreate and hold references to the image data, so release all the unused ones first
+    for(auto itr = _descriptorImages.begin(); itr != _descriptorImages.end();)
+    {
+        if (itr->second->referenceCount()==1) itr = _descriptorImages.erase(itr);
+        else ++itr;
+    }
+
+    using Unused = std::pair<uint64_t, decltype(_images)::iterator>;
+    std::vector<Unused> unused;
+    uint64_t unusedBytes = 0;
+    for(auto itr = _images.begin(); itr != _images.end(); ++itr)
+    {
+        if (itr->second.data->referenceCount()==1)
+        {
+            unused.emplace_back(itr->second.lastRequest, itr);
+            unusedBytes += itr->second.numBytes();
+        }
+    }
+
+    std::sort(unused.begin(), unused.end(), [](const Unused& lhs, const Unused& rhs) { return lhs.first < rhs.first; });
+
+    for(auto& [lastRequest, itr] : unused)
+    {
+        if (unusedBytes<=maxUnusedBytes) break;
+        unusedBytes -= itr->second.numBytes();
+        _images.erase(itr);
+    }
+}
+
+void TextureRegistry::clear()
+{
+    std::lock_guard<std::mutex> guard(_mutex);
+    _images.clear();
+    _descriptorImages.clear();
+}
@@ -0,0 +1,114 @@
+#include <osg2vsg/ViewSorter.h>
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+using namespace osg2vsg;
+
+namespace
+{
+    // +x, -x, +y, -y, +z, -z
+    int dominantAxis(const vsg::dvec3& direction)
+    {
+        vsg::dvec3 magnitude(std::abs(direction.x), std::abs(direction.y), std::abs(direction.z));
+        if (magnitude.x >= magnitude.y && magnitude.x >= magnitude.z) return direction.x >= 0.0 ? 0 : 1;
+        if (magnitude.y >= magnitude.z) return direction.y >= 0.0 ? 2 : 3;
+        return direction.z >= 0.0 ? 4 : 5;
+    }
+}
+
+void ViewSorter::addDepthSortedGroup(vsg::ref_ptr<vsg::Group> group, const std::vector<vsg::dvec3>& centres)
+{
+    if (!group || group->getNumChildren()!=centres.size())
+    {
+        std::cout<<"Warning: ViewSorter::addDepthSortedGroup() requires one centre per child, group not sorted."<<std::endl;
+        return;
+    }
+
+    DepthSortedGroup sorted;
+    sorted.group = group;
+    sorted.children = group->getChildren();
+    sorted.centres = centres;
+    sorted.order.resize(centres.size());
+    std::iota(sorted.order.begin(), sorted.order.end(), 0);
+    sorted.distances.resize(centres.size());
+
+    _depthSortedGroups.push_back(std::move(sorted));
+}
+
+void ViewSorter::addFrontToBackGroup(vsg::ref_ptr<vsg::Group> group, const std::vector<vsg::dvec3>& centres)
+{
+    if (!group || group->getNumChildren()!=centres.size())
+    {
+        std::cout<<"Warning: ViewSorter::addFrontToBackGroup() requires one centre per child, group not sorted."<<std::endl;
+        return;
+    }
+
+    const auto& children = group->getChildren();
+
+    FrontToBackGroup sorted;
+    sorted.group = group;
+    for (int axis=0; axis<3; ++axis)
+    {
+        std::vector<uint32_t> order(centres.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) { return centres[lhs][axis] < centres[rhs][axis]; });
+
+        // looking along +axis the smallest coordinates are nearest, looking along -axis the largest
+        auto& positive = sorted.axisChildren[axis*2];
+        auto& negative = sorted.axisChildren[axis*2+1];
+        for (auto index : order) positive.push_back(children[index]);
+        negative.assign(positive.rbegin(), positive.rend());
+    }
+
+    _frontToBackGroups.push_back(std::move(sorted));
+}
+
+void ViewSorter::sort(const vsg::dvec3& eye, const vsg::dvec3& viewDirection)
+{
+    for (auto& sorted : _depthSortedGroups)
+    {
+        for (size_t i=0; i<sorted.centres.size(); ++i)
+        {
+            auto delta = sorted.centres[i] - eye;
+            sorted.distances[i] = vsg::dot(delta, delta);
+        }
+
+        // insertion sort, farthest first, starting from last frame's order which is nearly sorted for a smoothly moving camera
+        bool changed = false;
+        auto& order = sorted.order;
+        for (size_t i=1; i<order.size(); ++i)
+        {
+            uint32_t index = order[i];
+            double distance = sorted.distances[index];
+            size_t j = i;
+            for (; j>0 && sorted.distances[order[j-1]] < distance; --j)
+            {
+                order[j] = order[j-1];
+            }
+            if (j!=i)
+            {
+                order[j] = index;
+                changed = true;
+            }
+        }
+
+        if (changed)
+        {
+            vsg::Group::Children children;
+            children.reserve(order.size());
+            for (auto index : order) children.push_back(sorted.children[index]);
+            sorted.group->setChildren(children);
+        }
+    }
+
+    int axis = dominantAxis(viewDirection);
+    for (auto& sorted : _frontToBackGroups)
+    {
+        if (sorted.axis==axis) continue;
+
+        sorted.group->setChildren(sorted.axisChildren[axis]);
+        sorted.axis = axis;
+    }
+}
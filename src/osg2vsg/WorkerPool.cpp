@@ -0,0 +1,125 @@
+#include <osg2vsg/WorkerPool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+using namespace osg2vsg;
+
+WorkerPool::WorkerPool(uint32_t numThreads)
+{
+    for(uint32_t i=0; i<numThreads; ++i)
+    {
+        _threads.emplace_back([this]()
+        {
+            while(true)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _condition.wait(lock, [this]() { return !_tasks.empty() || !_active; });
+
+                    // only exit once all the pending tasks have been run
+                    if (_tasks.empty()) return;
+
+                    task = std::move(_tasks.front());
+                    _tasks.pop_front();
+                }
+
+                task();
+            }
+        });
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _active = false;
+    }
+    _condition.notify_all();
+
+    for(auto& thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+void WorkerPool::add(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _tasks.push_back(std::move(task));
+    }
+    _condition.notify_one();
+}
+
+void WorkerPool::run(size_t count, const std::function<void(size_t)>& func)
+{
+    if (count==0) return;
+
+    struct Batch
+    {
+        std::function<void(size_t)> func;
+        size_t count = 0;
+        std::atomic<size_t> next{0};
+
+        std::atomic<bool> failed{false};
+
+        std::mutex mutex;
+        std::condition_variable completed;
+        size_t numCompleted = 0;
+        std::exception_ptr exception; // the first exception thrown by func, rethrown by run()
+
+        void process()
+        {
+            size_t numProcessed = 0;
+            for(size_t i = next++; i<count; i = next++)
+            {
+                // once a call has thrown the remaining indices are only counted, so run() can return and rethrow
+                if (!failed)
+                {
+                    try
+                    {
+                        func(i);
+                    }
+                    catch(...)
+                    {
+                        std::lock_guard<std::mutex> guard(mutex);
+                        if (!exception) exception = std::current_exception();
+                        failed = true;
+                    }
+                }
+                ++numProcessed;
+            }
+
+            if (numProcessed>0)
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                numCompleted += numProcessed;
+                if (numCompleted==count) completed.notify_all();
+            }
+        }
+    };
+
+    auto batch = std::make_shared<Batch>();
+    batch->func = func;
+    batch->count = count;
+
+    // tasks that start after the batch has been consumed simply return, they hold a reference to the batch so it outlives them
+    size_t numTasks = std::min(count-1, _threads.size());
+    for(size_t i=0; i<numTasks; ++i)
+    {
+        add([batch]() { batch->process(); });
+    }
+
+    batch->process();
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->completed.wait(lock, [&batch]() { return batch->numCompleted==batch->count; });
+
+    // all the calls have finished with func's captures, so the exception can unwind the caller's stack
+    if (batch->exception) std::rethrow_exception(batch->exception);
+}
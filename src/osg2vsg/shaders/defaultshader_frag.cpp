@@ -1,5 +1,5 @@
 char defaultshader_frag[] = "#version 450\n"
-                            "#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0, VSG_LIGHTING, VSG_DIFFUSE_MAP )\n"
+                            "#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0, VSG_LIGHTING, VSG_DIFFUSE_MAP, VSG_ALPHA_TEST )\n"
                             "#extension GL_ARB_separate_shader_objects : enable\n"
                             "#ifdef VSG_DIFFUSE_MAP\n"
                             "layout(binding = 0) uniform sampler2D diffuseMap;\n"
@@ -53,7 +53,13 @@ char defaultshader_frag[] = "#version 450\n"
                             "    vec4 color = base;\n"
                             "#endif\n"
                             "    outColor = color;\n"
+                            "#ifdef VSG_ALPHA_TEST\n"
+                            "    // binary alpha is resolved by the test so the geometry can be drawn without blending\n"
+                            "    if (outColor.a<0.5) discard;\n"
+                            "    outColor.a = 1.0;\n"
+                            "#else\n"
                             "    if (outColor.a==0.0) discard;\n"
+                            "#endif\n"
                             "}\n"
                             "\n"
                             "\n";
@@ -1,23 +1,64 @@
 char fbxshader_frag[] = "#version 450\n"
-                        "#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0, VSG_LIGHTING, VSG_MATERIAL, VSG_DIFFUSE_MAP, VSG_OPACITY_MAP, VSG_AMBIENT_MAP, VSG_NORMAL_MAP, VSG_SPECULAR_MAP )\n"
+                        "#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0, VSG_LIGHTING, VSG_MATERIAL, VSG_DIFFUSE_MAP, VSG_OPACITY_MAP, VSG_AMBIENT_MAP, VSG_NORMAL_MAP, VSG_NORMAL_MAP_XY, VSG_SPECULAR_MAP, VSG_ALPHA_TEST, VSG_MATERIAL_BUFFER, VSG_BINDLESS_TEXTURES )\n"
                         "#extension GL_ARB_separate_shader_objects : enable\n"
+                        "#ifdef VSG_BINDLESS_TEXTURES\n"
+                        "#extension GL_EXT_nonuniform_qualifier : require\n"
+                        "#endif\n"
+                        "#ifdef VSG_MATERIAL_BUFFER\n"
+                        "// the scene wide material buffer is bound to set 0, so the per state textures move to set 1\n"
+                        "#define TEXTURE_SET 1\n"
+                        "#else\n"
+                        "#define TEXTURE_SET 0\n"
+                        "#endif\n"
+                        "#ifdef VSG_BINDLESS_TEXTURES\n"
+                        "// every texture of the scene in one array, indexed by the texture indices held in the material\n"
+                        "layout(set = 0, binding = 11) uniform sampler2D textures[];\n"
+                        "#define diffuseMap textures[nonuniformEXT(material.diffuseMapIndex)]\n"
+                        "#define opacityMap textures[nonuniformEXT(material.opacityMapIndex)]\n"
+                        "#define ambientMap textures[nonuniformEXT(material.ambientMapIndex)]\n"
+                        "#define normalMap textures[nonuniformEXT(material.normalMapIndex)]\n"
+                        "#define specularMap textures[nonuniformEXT(material.specularMapIndex)]\n"
+                        "#else\n"
                         "#ifdef VSG_DIFFUSE_MAP\n"
-                        "layout(binding = 0) uniform sampler2D diffuseMap;\n"
+                        "layout(set = TEXTURE_SET, binding = 0) uniform sampler2D diffuseMap;\n"
                         "#endif\n"
                         "#ifdef VSG_OPACITY_MAP\n"
-                        "layout(binding = 1) uniform sampler2D opacityMap;\n"
+                        "layout(set = TEXTURE_SET, binding = 1) uniform sampler2D opacityMap;\n"
                         "#endif\n"
                         "#ifdef VSG_AMBIENT_MAP\n"
-                        "layout(binding = 4) uniform sampler2D ambientMap;\n"
+                        "layout(set = TEXTURE_SET, binding = 4) uniform sampler2D ambientMap;\n"
                         "#endif\n"
                         "#ifdef VSG_NORMAL_MAP\n"
-                        "layout(binding = 5) uniform sampler2D normalMap;\n"
+                        "layout(set = TEXTURE_SET, binding = 5) uniform sampler2D normalMap;\n"
                         "#endif\n"
                         "#ifdef VSG_SPECULAR_MAP\n"
-                        "layout(binding = 6) uniform sampler2D specularMap;\n"
+                        "layout(set = TEXTURE_SET, binding = 6) uniform sampler2D specularMap;\n"
+                        "#endif\n"
                         "#endif\n"
                         "\n"
-                        "#ifdef VSG_MATERIAL\n"
+                        "#ifdef VSG_MATERIAL_BUFFER\n"
+                        "struct MaterialData\n"
+                        "{\n"
+                        "    vec4 ambientColor;\n"
+                        "    vec4 diffuseColor;\n"
+                        "    vec4 specularColor;\n"
+                        "    float shininess;\n"
+                        "    uint diffuseMapIndex;\n"
+                        "    uint opacityMapIndex;\n"
+                        "    uint ambientMapIndex;\n"
+                        "    uint normalMapIndex;\n"
+                        "    uint specularMapIndex;\n"
+                        "};\n"
+                        "layout(set = 0, binding = 10) readonly buffer MaterialBuffer\n"
+                        "{\n"
+                        "    MaterialData materials[];\n"
+                        "};\n"
+                        "layout(push_constant) uniform MaterialIndex\n"
+                        "{\n"
+                        "    layout(offset = 128) uint materialIndex;\n"
+                        "} pc;\n"
+                        "#define material materials[pc.materialIndex]\n"
+                        "#elif defined(VSG_MATERIAL)\n"
                         "layout(binding = 10) uniform MaterialData\n"
                         "{\n"
                         "    vec4 ambientColor;\n"
@@ -71,7 +112,14 @@ char fbxshader_frag[] = "#version 450\n"
                         "#endif\n"
                         "#ifdef VSG_LIGHTING\n"
                         "#ifdef VSG_NORMAL_MAP\n"
+                        "#ifdef VSG_NORMAL_MAP_XY\n"
+                        "    // two channel normal maps, such as BC5, only hold x and y so z is reconstructed\n"
+                        "    vec3 nDir;\n"
+                        "    nDir.xy = texture(normalMap, texCoord0.st).xy*2.0 - 1.0;\n"
+                        "    nDir.z = sqrt(max(1.0 - dot(nDir.xy, nDir.xy), 0.0));\n"
+                        "#else\n"
                         "    vec3 nDir = texture(normalMap, texCoord0.st).xyz*2.0 - 1.0;\n"
+                        "#endif\n"
                         "    nDir.g = -nDir.g;\n"
                         "#else\n"
                         "    vec3 nDir = normalDir;\n"
@@ -98,6 +146,12 @@ char fbxshader_frag[] = "#version 450\n"
                         "#ifdef VSG_OPACITY_MAP\n"
                         "    outColor.a *= texture(opacityMap, texCoord0.st).r;\n"
                         "#endif\n"
+                        "#ifdef VSG_ALPHA_TEST\n"
+                        "    // binary alpha is resolved by the test so the geometry can be drawn without blending\n"
+                        "    if (outColor.a<0.5) discard;\n"
+                        "    outColor.a = 1.0;\n"
+                        "#else\n"
                         "    if (outColor.a==0.0) discard;\n"
+                        "#endif\n"
                         "}\n"
                         "\n";